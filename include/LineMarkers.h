@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Values anchored to lines, such as error markers and breakpoints, kept in a
+// treap ordered by line. Inserting or removing lines moves every marker after
+// them in O(log n): the markers past the edit are split off as one subtree and
+// tagged with the shift, which reaches a node's children only when they are
+// next visited.
+template <class T>
+class LineMarkers
+{
+	struct Node;
+	typedef std::unique_ptr<Node> NodePtr;
+
+	struct Node
+	{
+		int mLine;
+		int mShift = 0;	// still to be added to the lines of everything below
+		uint32_t mPriority;
+		T mValue;
+		NodePtr mLeft, mRight;
+
+		Node(int aLine, T aValue, uint32_t aPriority) : mLine(aLine), mPriority(aPriority), mValue(std::move(aValue)) {}
+	};
+
+public:
+	LineMarkers() = default;
+	LineMarkers(LineMarkers&&) = default;
+	LineMarkers& operator=(LineMarkers&&) = default;
+	LineMarkers(const LineMarkers& o) : mRoot(Clone(o.mRoot.get(), 0)), mSeed(o.mSeed) {}
+	LineMarkers& operator=(const LineMarkers& o) { return *this = LineMarkers(o); }
+
+	bool empty() const { return !mRoot; }
+	void clear() { mRoot.reset(); }
+
+	const T* find(int aLine) const
+	{
+		int shift = 0;
+		for (const Node* n = mRoot.get(); n != nullptr; )
+		{
+			int line = n->mLine + shift;
+			if (line == aLine)
+				return &n->mValue;
+			shift += n->mShift;
+			n = aLine < line ? n->mLeft.get() : n->mRight.get();
+		}
+		return nullptr;
+	}
+
+	// Replaces the marker on aLine, if there is one.
+	void set(int aLine, T aValue)
+	{
+		NodePtr left, middle, right;
+		Split(std::move(mRoot), aLine, left, right);
+		Split(std::move(right), aLine + 1, middle, right);
+		middle.reset(new Node(aLine, std::move(aValue), NextPriority()));
+		mRoot = Merge(Merge(std::move(left), std::move(middle)), std::move(right));
+	}
+
+	void erase(int aLine)
+	{
+		NodePtr left, middle, right;
+		Split(std::move(mRoot), aLine, left, right);
+		Split(std::move(right), aLine + 1, middle, right);
+		mRoot = Merge(std::move(left), std::move(right));
+	}
+
+	// aCount lines inserted before aLine: the markers from aLine on move down.
+	void insert_lines(int aLine, int aCount)
+	{
+		NodePtr left, right;
+		Split(std::move(mRoot), aLine, left, right);
+		Shift(right.get(), aCount);
+		mRoot = Merge(std::move(left), std::move(right));
+	}
+
+	// Lines [aFirst, aLast) removed: their markers go, the ones after move up.
+	void erase_lines(int aFirst, int aLast)
+	{
+		NodePtr left, middle, right;
+		Split(std::move(mRoot), aFirst, left, right);
+		Split(std::move(right), aLast, middle, right);
+		Shift(right.get(), aFirst - aLast);
+		mRoot = Merge(std::move(left), std::move(right));
+	}
+
+	// aFunction(line, value) for the markers on [aFirst, aLast), in line order.
+	template <class F>
+	void for_each(int aFirst, int aLast, F&& aFunction) const
+	{
+		Visit(mRoot.get(), 0, aFirst, aLast, aFunction);
+	}
+
+private:
+	static void Shift(Node* n, int aDelta)
+	{
+		if (n != nullptr)
+		{
+			n->mLine += aDelta;
+			n->mShift += aDelta;
+		}
+	}
+
+	static void Push(Node* n)
+	{
+		if (n->mShift != 0)
+		{
+			Shift(n->mLeft.get(), n->mShift);
+			Shift(n->mRight.get(), n->mShift);
+			n->mShift = 0;
+		}
+	}
+
+	// The markers before aLine into aLeft, the rest into aRight.
+	static void Split(NodePtr n, int aLine, NodePtr& aLeft, NodePtr& aRight)
+	{
+		if (!n)
+		{
+			aLeft.reset();
+			aRight.reset();
+			return;
+		}
+
+		Push(n.get());
+		if (n->mLine < aLine)
+		{
+			Split(std::move(n->mRight), aLine, n->mRight, aRight);
+			aLeft = std::move(n);
+		}
+		else
+		{
+			Split(std::move(n->mLeft), aLine, aLeft, n->mLeft);
+			aRight = std::move(n);
+		}
+	}
+
+	// All of a, then all of b, every line in a before those in b.
+	static NodePtr Merge(NodePtr a, NodePtr b)
+	{
+		if (!a)
+			return b;
+		if (!b)
+			return a;
+
+		if (a->mPriority >= b->mPriority)
+		{
+			Push(a.get());
+			a->mRight = Merge(std::move(a->mRight), std::move(b));
+			return a;
+		}
+
+		Push(b.get());
+		b->mLeft = Merge(std::move(a), std::move(b->mLeft));
+		return b;
+	}
+
+	template <class F>
+	static void Visit(const Node* n, int aShift, int aFirst, int aLast, F& aFunction)
+	{
+		if (n == nullptr)
+			return;
+
+		int line = n->mLine + aShift;
+		aShift += n->mShift;
+		if (line > aFirst)
+			Visit(n->mLeft.get(), aShift, aFirst, aLast, aFunction);
+		if (line >= aFirst && line < aLast)
+			aFunction(line, n->mValue);
+		if (line < aLast - 1)
+			Visit(n->mRight.get(), aShift, aFirst, aLast, aFunction);
+	}
+
+	static NodePtr Clone(const Node* n, int aShift)
+	{
+		if (n == nullptr)
+			return NodePtr();
+
+		NodePtr copy(new Node(n->mLine + aShift, n->mValue, n->mPriority));
+		aShift += n->mShift;
+		copy->mLeft = Clone(n->mLeft.get(), aShift);
+		copy->mRight = Clone(n->mRight.get(), aShift);
+		return copy;
+	}
+
+	uint32_t NextPriority()
+	{
+		// xorshift, as in LineRope
+		mSeed ^= mSeed << 13;
+		mSeed ^= mSeed >> 17;
+		mSeed ^= mSeed << 5;
+		return mSeed;
+	}
+
+	NodePtr mRoot;
+	uint32_t mSeed = 0x9e3779b9u;
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A sequence of lines kept in a balanced tree (a treap keyed by position), so
+// inserting or erasing a line anywhere costs O(log n) instead of moving every
+// line after it, and finding line i is O(log n).
+//
+// Copies are O(1) snapshots: both copies share the tree, and a change copies
+// only the nodes on the path to what it changes, the rest stays shared. Lines
+// reached through a shared node are never written in place, so a snapshot can
+// be read on another thread while the original is edited.
+//
+// The interface follows std::vector where TextEditor needs it, with positions
+// instead of iterators. References stay valid until the next insert or erase,
+// as with a vector, or until a snapshot is taken and the line is changed.
+template <class T>
+class LineRope
+{
+	struct Node;
+	typedef std::shared_ptr<Node> NodePtr;
+
+	struct Node
+	{
+		T mValue;
+		size_t mCount = 1;	// nodes in this subtree
+		uint32_t mPriority = 0;
+		NodePtr mLeft, mRight;
+
+		Node(T&& aValue, uint32_t aPriority) : mValue(std::move(aValue)), mPriority(aPriority) {}
+	};
+
+public:
+	class const_iterator
+	{
+	public:
+		const T& operator*() const { return mStack.back()->mValue; }
+		const T* operator->() const { return &mStack.back()->mValue; }
+		bool operator==(const const_iterator& o) const { return mStack == o.mStack; }
+		bool operator!=(const const_iterator& o) const { return mStack != o.mStack; }
+
+		const_iterator& operator++()
+		{
+			const Node* n = mStack.back();
+			mStack.pop_back();
+			DescendLeft(n->mRight.get());
+			return *this;
+		}
+
+	private:
+		friend class LineRope;
+
+		// in order walk, the stack holds the nodes whose left side is done
+		void DescendLeft(const Node* n)
+		{
+			for (; n != nullptr; n = n->mLeft.get())
+				mStack.push_back(n);
+		}
+
+		std::vector<const Node*> mStack;
+	};
+
+	LineRope() = default;
+
+	size_t size() const { return Count(mRoot); }
+	bool empty() const { return !mRoot; }
+
+	const T& operator[](size_t aIndex) const
+	{
+		assert(aIndex < size());
+		const Node* n = mRoot.get();
+		for (;;)
+		{
+			size_t left = Count(n->mLeft);
+			if (aIndex < left)
+				n = n->mLeft.get();
+			else if (aIndex == left)
+				return n->mValue;
+			else
+			{
+				aIndex -= left + 1;
+				n = n->mRight.get();
+			}
+		}
+	}
+
+	T& operator[](size_t aIndex)
+	{
+		assert(aIndex < size());
+		NodePtr* link = &mRoot;
+		for (;;)
+		{
+			Node* n = Unshare(*link);
+			size_t left = Count(n->mLeft);
+			if (aIndex < left)
+				link = &n->mLeft;
+			else if (aIndex == left)
+				return n->mValue;
+			else
+			{
+				aIndex -= left + 1;
+				link = &n->mRight;
+			}
+		}
+	}
+
+	const T& back() const { return (*this)[size() - 1]; }
+	T& back() { return (*this)[size() - 1]; }
+
+	const_iterator begin() const
+	{
+		const_iterator it;
+		it.DescendLeft(mRoot.get());
+		return it;
+	}
+
+	const_iterator end() const { return const_iterator(); }
+
+	// An iterator at line aIndex, for walking a range without a search per line.
+	const_iterator iterate_from(size_t aIndex) const
+	{
+		const_iterator it;
+		const Node* n = mRoot.get();
+		while (n != nullptr)
+		{
+			size_t left = Count(n->mLeft);
+			if (aIndex < left)
+			{
+				it.mStack.push_back(n);
+				n = n->mLeft.get();
+			}
+			else if (aIndex == left)
+			{
+				it.mStack.push_back(n);
+				break;
+			}
+			else
+			{
+				aIndex -= left + 1;
+				n = n->mRight.get();
+			}
+		}
+		return it;
+	}
+
+	void clear() { mRoot.reset(); }
+
+	// Replaces the contents in O(n), without a search per line.
+	void assign(std::vector<T>&& aValues)
+	{
+		// The treap for a given order and set of priorities is unique: the
+		// Cartesian tree, built left to right keeping the right spine on a stack.
+		std::vector<NodePtr> spine;
+		for (auto& value : aValues)
+		{
+			NodePtr node = std::make_shared<Node>(std::move(value), NextPriority());
+			NodePtr last;
+			while (!spine.empty() && spine.back()->mPriority < node->mPriority)
+			{
+				last = std::move(spine.back());
+				spine.pop_back();
+				Update(last.get());
+			}
+			node->mLeft = std::move(last);
+			if (!spine.empty())
+				spine.back()->mRight = node;
+			spine.push_back(std::move(node));
+		}
+		while (spine.size() > 1)
+		{
+			Update(spine.back().get());
+			spine.pop_back();
+		}
+		if (!spine.empty())
+			Update(spine.back().get());
+		mRoot = spine.empty() ? NodePtr() : std::move(spine.front());
+	}
+
+	T& insert(size_t aIndex, T&& aValue)
+	{
+		assert(aIndex <= size());
+		NodePtr node = std::make_shared<Node>(std::move(aValue), NextPriority());
+		T& result = node->mValue;
+
+		NodePtr left, right;
+		Split(std::move(mRoot), aIndex, left, right);
+		mRoot = Merge(Merge(std::move(left), std::move(node)), std::move(right));
+		return result;
+	}
+
+	T& insert(size_t aIndex, const T& aValue) { return insert(aIndex, T(aValue)); }
+	void push_back(T&& aValue) { insert(size(), std::move(aValue)); }
+	void push_back(const T& aValue) { insert(size(), T(aValue)); }
+
+	// Removes [aFirst, aLast).
+	void erase(size_t aFirst, size_t aLast)
+	{
+		assert(aFirst <= aLast && aLast <= size());
+		NodePtr left, middle, right;
+		Split(std::move(mRoot), aFirst, left, middle);
+		Split(std::move(middle), aLast - aFirst, middle, right);
+		mRoot = Merge(std::move(left), std::move(right));
+	}
+
+	void erase(size_t aIndex) { erase(aIndex, aIndex + 1); }
+
+private:
+	static size_t Count(const NodePtr& n) { return n ? n->mCount : 0; }
+	static void Update(Node* n) { n->mCount = 1 + Count(n->mLeft) + Count(n->mRight); }
+
+	// A node this rope may write to: the node itself when nothing else holds
+	// it, otherwise a copy that takes its place here.
+	static Node* Unshare(NodePtr& n)
+	{
+		if (n.use_count() > 1)
+			n = std::make_shared<Node>(*n);
+		return n.get();
+	}
+
+	// The first aCount lines of n into aLeft, the rest into aRight.
+	static void Split(NodePtr n, size_t aCount, NodePtr& aLeft, NodePtr& aRight)
+	{
+		if (!n)
+		{
+			aLeft.reset();
+			aRight.reset();
+			return;
+		}
+
+		Node* node = Unshare(n);
+		if (aCount <= Count(node->mLeft))
+		{
+			Split(std::move(node->mLeft), aCount, aLeft, node->mLeft);
+			Update(node);
+			aRight = std::move(n);
+		}
+		else
+		{
+			Split(std::move(node->mRight), aCount - Count(node->mLeft) - 1, node->mRight, aRight);
+			Update(node);
+			aLeft = std::move(n);
+		}
+	}
+
+	// All of a, then all of b.
+	static NodePtr Merge(NodePtr a, NodePtr b)
+	{
+		if (!a)
+			return b;
+		if (!b)
+			return a;
+
+		if (a->mPriority >= b->mPriority)
+		{
+			Node* node = Unshare(a);
+			node->mRight = Merge(std::move(node->mRight), std::move(b));
+			Update(node);
+			return a;
+		}
+
+		Node* node = Unshare(b);
+		node->mLeft = Merge(std::move(a), std::move(node->mLeft));
+		Update(node);
+		return b;
+	}
+
+	uint32_t NextPriority()
+	{
+		// xorshift, the tree only needs priorities that look random
+		mSeed ^= mSeed << 13;
+		mSeed ^= mSeed >> 17;
+		mSeed ^= mSeed << 5;
+		return mSeed;
+	}
+
+	NodePtr mRoot;
+	uint32_t mSeed = 0x9e3779b9u;
+};
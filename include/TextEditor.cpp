@@ -11,18 +11,6 @@
 // TODO
 // - multiline comments vs single-line: latter is blocking start of a ML
 
-template<class InputIt1, class InputIt2, class BinaryPredicate>
-bool equals(InputIt1 first1, InputIt1 last1,
-	InputIt2 first2, InputIt2 last2, BinaryPredicate p)
-{
-	for (; first1 != last1 && first2 != last2; ++first1, ++first2)
-	{
-		if (!p(*first1, *first2))
-			return false;
-	}
-	return first1 == last1 && first2 == last2;
-}
-
 TextEditor::TextEditor()
 	: mLineSpacing(1.0f)
 	, mUndoIndex(0)
@@ -39,8 +27,16 @@ TextEditor::TextEditor()
 	, mCursorPositionChanged(false)
 	, mColorRangeMin(0)
 	, mColorRangeMax(0)
+	, mCommentRangeMin(0)
+	, mCommentRangeMax(0)
 	, mSelectionMode(SelectionMode::Normal)
 	, mCheckComments(true)
+	, mLayoutFont(nullptr)
+	, mLayoutFontSize(0.0f)
+	, mLayoutGeneration(1)
+	, mLayoutFrame(0)
+	, mSpaceSize(0.0f)
+	, mDigitAdvance()
 	, mLastClick(-1.0f)
 	, mHandleKeyboardInputs(true)
 	, mHandleMouseInputs(true)
@@ -73,6 +69,20 @@ void TextEditor::SetPalette(const Palette& aValue)
 	mPaletteBase = aValue;
 }
 
+void TextEditor::SetErrorMarkers(const ErrorMarkers& aMarkers)
+{
+	mErrorMarkers.clear();
+	for (auto& i : aMarkers)
+		mErrorMarkers.set(i.first, i.second);
+}
+
+void TextEditor::SetBreakpoints(const Breakpoints& aMarkers)
+{
+	mBreakpoints.clear();
+	for (auto i : aMarkers)
+		mBreakpoints.set(i, true);
+}
+
 std::string TextEditor::GetText(const Coordinates& aStart, const Coordinates& aEnd) const
 {
 	std::string result;
@@ -83,26 +93,33 @@ std::string TextEditor::GetText(const Coordinates& aStart, const Coordinates& aE
 	auto iend = GetCharacterIndex(aEnd);
 	size_t s = 0;
 
-	for (size_t i = lstart; i < lend; i++)
-		s += mLines[i].size();
+	// walk the lines instead of finding each one, that is not free
+	auto first = mLines.iterate_from(lstart);
+	auto it = first;
+	for (auto i = lstart; i < lend && it != mLines.end(); ++i, ++it)
+		s += it->size();
 
 	result.reserve(s + s / 8);
 
+	it = first;
 	while (istart < iend || lstart < lend)
 	{
-		if (lstart >= (int)mLines.size())
+		if (it == mLines.end())
 			break;
 
-		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
+		auto& line = *it;
+		auto stop = lstart < lend ? (int)line.size() : std::min(iend, (int)line.size());
+		if (istart < stop)
 		{
-			result += line[istart].mChar;
-			istart++;
+			result.append(line.mChars, istart, stop - istart);
+			istart = stop;
 		}
-		else
+
+		if (istart < iend || lstart < lend)
 		{
 			istart = 0;
 			++lstart;
+			++it;
 			result += '\n';
 		}
 	}
@@ -204,7 +221,7 @@ void TextEditor::Advance(Coordinates& aCoordinates) const
 
 		if (cindex + 1 < (int)line.size())
 		{
-			auto delta = UTF8CharLength(line[cindex].mChar);
+			auto delta = UTF8CharLength(line.GetChar(cindex));
 			cindex = std::min(cindex + delta, (int)line.size() - 1);
 		}
 		else
@@ -234,20 +251,20 @@ void TextEditor::DeleteRange(const Coordinates& aStart, const Coordinates& aEnd)
 		auto& line = mLines[aStart.mLine];
 		auto n = GetLineMaxColumn(aStart.mLine);
 		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
+			line.Erase(start, line.size());
 		else
-			line.erase(line.begin() + start, line.begin() + end);
+			line.Erase(start, end);
 	}
 	else
 	{
 		auto& firstLine = mLines[aStart.mLine];
 		auto& lastLine = mLines[aEnd.mLine];
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		firstLine.Erase(start, firstLine.size());
+		lastLine.Erase(0, end);
 
 		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+			firstLine.Insert(firstLine.size(), lastLine, 0, lastLine.size());
 
 		if (aStart.mLine < aEnd.mLine)
 			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
@@ -277,8 +294,8 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char* aValue
 			{
 				auto& newLine = InsertLine(aWhere.mLine + 1);
 				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
+				newLine.Insert(0, line, cindex, line.size());
+				line.Erase(cindex, line.size());
 			}
 			else
 			{
@@ -292,11 +309,20 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char* aValue
 		}
 		else
 		{
+			// the rest of the line goes in with one insert
+			auto runEnd = aValue;
+			while (*runEnd != '\0' && *runEnd != '\n' && *runEnd != '\r')
+				++runEnd;
+
 			auto& line = mLines[aWhere.mLine];
-			auto d = UTF8CharLength(*aValue);
-			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+			line.Insert(cindex, aValue, runEnd);
+			cindex += (int)(runEnd - aValue);
+
+			while (aValue < runEnd)
+			{
+				aValue += std::min((int)(runEnd - aValue), UTF8CharLength(*aValue));
+				++aWhere.mColumn;
+			}
 		}
 
 		mTextChanged = true;
@@ -331,41 +357,24 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 
 	if (lineNo >= 0 && lineNo < (int)mLines.size())
 	{
-		auto& line = mLines.at(lineNo);
+		auto& line = mLines[lineNo];
 
-		int columnIndex = 0;
-		float columnX = 0.0f;
+		auto& layout = GetLineLayout(line);
 
+		int columnIndex = 0;
 		while ((size_t)columnIndex < line.size())
 		{
-			float columnWidth = 0.0f;
+			// past the middle of a character is the column after it
+			auto c = line.GetChar(columnIndex);
+			auto next = std::min(columnIndex + UTF8CharLength(c), (int)line.size());
+			if (mTextStart + (layout.mX[columnIndex] + layout.mX[next]) * 0.5f > local.x)
+				break;
 
-			if (line[columnIndex].mChar == '\t')
-			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX = newColumnX;
+			if (c == '\t')
 				columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
-				columnIndex++;
-			}
 			else
-			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].mChar);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].mChar;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX += columnWidth;
 				columnCoord++;
-			}
+			columnIndex = next;
 		}
 	}
 
@@ -384,13 +393,13 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates& aFrom) cons
 	if (cindex >= (int)line.size())
 		return at;
 
-	while (cindex > 0 && isspace(line[cindex].mChar))
+	while (cindex > 0 && isspace(line.GetChar(cindex)))
 		--cindex;
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex > 0)
 	{
-		auto c = line[cindex].mChar;
+		auto c = line.GetChar(cindex);
 		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
 		{
 			if (c <= 32 && isspace(c))
@@ -398,7 +407,7 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates& aFrom) cons
 				cindex++;
 				break;
 			}
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].mColorIndex)
+			if (cstart != line.GetColorIndex(size_t(cindex - 1)))
 				break;
 		}
 		--cindex;
@@ -418,19 +427,19 @@ TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates& aFrom) const
 	if (cindex >= (int)line.size())
 		return at;
 
-	bool prevspace = isspace(line[cindex].mChar) != 0;
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	bool prevspace = isspace(line.GetChar(cindex)) != 0;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex < (int)line.size())
 	{
-		auto c = line[cindex].mChar;
+		auto c = line.GetChar(cindex);
 		auto d = UTF8CharLength(c);
-		if (cstart != (PaletteIndex)line[cindex].mColorIndex)
+		if (cstart != line.GetColorIndex(cindex))
 			break;
 
 		if (prevspace != !!isspace(c))
 		{
 			if (isspace(c))
-				while (cindex < (int)line.size() && isspace(line[cindex].mChar))
+				while (cindex < (int)line.size() && isspace(line.GetChar(cindex)))
 					++cindex;
 			break;
 		}
@@ -452,7 +461,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates& aFrom) const
 	if (cindex < (int)mLines[at.mLine].size())
 	{
 		auto& line = mLines[at.mLine];
-		isword = isalnum(line[cindex].mChar) != 0;
+		isword = isalnum(line.GetChar(cindex)) != 0;
 		skip = isword;
 	}
 
@@ -467,7 +476,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates& aFrom) const
 		auto& line = mLines[at.mLine];
 		if (cindex < (int)line.size())
 		{
-			isword = isalnum(line[cindex].mChar) != 0;
+			isword = isalnum(line.GetChar(cindex)) != 0;
 
 			if (isword && !skip)
 				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
@@ -498,11 +507,11 @@ int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 	int i = 0;
 	for (; i < line.size() && c < aCoordinates.mColumn;)
 	{
-		if (line[i].mChar == '\t')
+		if (line.GetChar(i) == '\t')
 			c = (c / mTabSize) * mTabSize + mTabSize;
 		else
 			++c;
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line.GetChar(i));
 	}
 	return i;
 }
@@ -516,7 +525,7 @@ int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 	int i = 0;
 	while (i < aIndex && i < (int)line.size())
 	{
-		auto c = line[i].mChar;
+		auto c = line.GetChar(i);
 		i += UTF8CharLength(c);
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
@@ -533,7 +542,7 @@ int TextEditor::GetLineCharacterCount(int aLine) const
 	auto& line = mLines[aLine];
 	int c = 0;
 	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line.GetChar(i));
 	return c;
 }
 
@@ -545,7 +554,7 @@ int TextEditor::GetLineMaxColumn(int aLine) const
 	int col = 0;
 	for (unsigned i = 0; i < line.size(); )
 	{
-		auto c = line[i].mChar;
+		auto c = line.GetChar(i);
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
 		else
@@ -566,9 +575,9 @@ bool TextEditor::IsOnWordBoundary(const Coordinates& aAt) const
 		return true;
 
 	if (mColorizerEnabled)
-		return line[cindex].mColorIndex != line[size_t(cindex - 1)].mColorIndex;
+		return line.GetColorIndex(cindex) != line.GetColorIndex(size_t(cindex - 1));
 
-	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
+	return isspace(line.GetChar(cindex)) != isspace(line.GetChar(cindex - 1));
 }
 
 void TextEditor::RemoveLine(int aStart, int aEnd)
@@ -577,26 +586,11 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 	assert(aEnd >= aStart);
 	assert(mLines.size() > (size_t)(aEnd - aStart));
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
-	{
-		ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
-		if (e.first >= aStart && e.first <= aEnd)
-			continue;
-		etmp.insert(e);
-	}
-	mErrorMarkers = std::move(etmp);
-
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
-	{
-		if (i >= aStart && i <= aEnd)
-			continue;
-		btmp.insert(i >= aStart ? i - 1 : i);
-	}
-	mBreakpoints = std::move(btmp);
+	// markers are kept by line number, one past the index
+	mErrorMarkers.erase_lines(aStart + 1, aEnd + 1);
+	mBreakpoints.erase_lines(aStart + 1, aEnd + 1);
 
-	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
+	mLines.erase(aStart, aEnd);
 	assert(!mLines.empty());
 
 	mTextChanged = true;
@@ -607,26 +601,10 @@ void TextEditor::RemoveLine(int aIndex)
 	assert(!mReadOnly);
 	assert(mLines.size() > 1);
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
-	{
-		ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
-		if (e.first - 1 == aIndex)
-			continue;
-		etmp.insert(e);
-	}
-	mErrorMarkers = std::move(etmp);
+	mErrorMarkers.erase_lines(aIndex + 1, aIndex + 2);
+	mBreakpoints.erase_lines(aIndex + 1, aIndex + 2);
 
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
-	{
-		if (i == aIndex)
-			continue;
-		btmp.insert(i >= aIndex ? i - 1 : i);
-	}
-	mBreakpoints = std::move(btmp);
-
-	mLines.erase(mLines.begin() + aIndex);
+	mLines.erase(aIndex);
 	assert(!mLines.empty());
 
 	mTextChanged = true;
@@ -636,17 +614,10 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 {
 	assert(!mReadOnly);
 
-	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	auto& result = mLines.insert(aIndex, Line());
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
-		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
-	mErrorMarkers = std::move(etmp);
-
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
-		btmp.insert(i >= aIndex ? i + 1 : i);
-	mBreakpoints = std::move(btmp);
+	mErrorMarkers.insert_lines(aIndex + 1, 1);
+	mBreakpoints.insert_lines(aIndex + 1, 1);
 
 	return result;
 }
@@ -667,22 +638,22 @@ std::string TextEditor::GetWordAt(const Coordinates& aCoords) const
 	auto istart = GetCharacterIndex(start);
 	auto iend = GetCharacterIndex(end);
 
-	for (auto it = istart; it < iend; ++it)
-		r.push_back(mLines[aCoords.mLine][it].mChar);
+	if (istart < iend)
+		r.assign(mLines[aCoords.mLine].mChars, istart, iend - istart);
 
 	return r;
 }
 
-ImU32 TextEditor::GetGlyphColor(const Glyph& aGlyph) const
+ImU32 TextEditor::GetGlyphColor(Attribute aAttribute) const
 {
 	if (!mColorizerEnabled)
 		return mPalette[(int)PaletteIndex::Default];
-	if (aGlyph.mComment)
+	if (aAttribute & CommentFlag)
 		return mPalette[(int)PaletteIndex::Comment];
-	if (aGlyph.mMultiLineComment)
+	if (aAttribute & MultiLineCommentFlag)
 		return mPalette[(int)PaletteIndex::MultiLineComment];
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
+	auto const color = mPalette[aAttribute & ColorMask];
+	if (aAttribute & PreprocessorFlag)
 	{
 		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
 		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
@@ -852,9 +823,8 @@ void TextEditor::HandleMouseInputs()
 
 void TextEditor::Render()
 {
-	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
-	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
-	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
+	/* mCharAdvance.x follows the scaled font size (Ctrl + mouse wheel) in UpdateLayoutMetrics */
+	mCharAdvance.y = ImGui::GetTextLineHeightWithSpacing() * mLineSpacing;
 
 	/* Update palette with the current alpha from style */
 	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
@@ -864,7 +834,6 @@ void TextEditor::Render()
 		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
 	}
 
-	assert(mLineBuffer.empty());
 
 	auto contentSize = ImGui::GetWindowContentRegionMax();
 	auto drawList = ImGui::GetWindowDrawList();
@@ -887,22 +856,29 @@ void TextEditor::Render()
 	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
 	char buf[16];
 	snprintf(buf, 16, " %d ", globalLineMax);
-	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
+	mTextStart = GetNumberWidth(buf) + mLeftMargin;
 
 	if (!mLines.empty())
 	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+		// the markers on the visible lines, found in one walk each
+		std::vector<std::pair<int, const std::string*>> errors;
+		mErrorMarkers.for_each(lineNo + 1, lineMax + 2, [&](int aLine, const std::string& aText) { errors.emplace_back(aLine, &aText); });
+		std::vector<int> breakpoints;
+		mBreakpoints.for_each(lineNo + 1, lineMax + 2, [&](int aLine, bool) { breakpoints.push_back(aLine); });
+		auto errorIt = errors.begin();
+		auto breakpointIt = breakpoints.begin();
 
 		while (lineNo <= lineMax)
 		{
 			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + lineNo * mCharAdvance.y);
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 
+			// nothing below measures text, the layout has it unless the line changed
 			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
+			auto& layout = GetLineLayout(line);
+			longest = std::max(mTextStart + layout.mX.back(), longest);
 			Coordinates lineStartCoord(lineNo, 0);
-			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+			Coordinates lineEndCoord(lineNo, layout.mColumns);
 
 			// Draw selection for the current line
 			float sstart = -1.0f;
@@ -912,7 +888,7 @@ void TextEditor::Render()
 			if (mState.mSelectionStart <= lineEndCoord)
 				sstart = mState.mSelectionStart > lineStartCoord ? TextDistanceToLineStart(mState.mSelectionStart) : 0.0f;
 			if (mState.mSelectionEnd > lineStartCoord)
-				ssend = TextDistanceToLineStart(mState.mSelectionEnd < lineEndCoord ? mState.mSelectionEnd : lineEndCoord);
+				ssend = mState.mSelectionEnd < lineEndCoord ? TextDistanceToLineStart(mState.mSelectionEnd) : layout.mX.back();
 
 			if (mState.mSelectionEnd.mLine > lineNo)
 				ssend += mCharAdvance.x;
@@ -927,15 +903,15 @@ void TextEditor::Render()
 			// Draw breakpoints
 			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
 
-			if (mBreakpoints.count(lineNo + 1) != 0)
+			if (breakpointIt != breakpoints.end() && *breakpointIt == lineNo + 1)
 			{
+				++breakpointIt;
 				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
 				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::Breakpoint]);
 			}
 
 			// Draw error markers
-			auto errorIt = mErrorMarkers.find(lineNo + 1);
-			if (errorIt != mErrorMarkers.end())
+			if (errorIt != errors.end() && errorIt->first == lineNo + 1)
 			{
 				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
 				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::ErrorMarker]);
@@ -948,16 +924,17 @@ void TextEditor::Render()
 					ImGui::PopStyleColor();
 					ImGui::Separator();
 					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 1.0f, 0.2f, 1.0f));
-					ImGui::Text("%s", errorIt->second.c_str());
+					ImGui::Text("%s", errorIt->second->c_str());
 					ImGui::PopStyleColor();
 					ImGui::EndTooltip();
 				}
+				++errorIt;
 			}
 
 			// Draw line number (right aligned)
 			snprintf(buf, 16, "%d  ", lineNo + 1);
 
-			auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
+			auto lineNoWidth = GetNumberWidth(buf);
 			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
 
 			if (mState.mCursorPosition.mLine == lineNo)
@@ -985,19 +962,8 @@ void TextEditor::Render()
 
 						if (mOverwrite && cindex < (int)line.size())
 						{
-							auto c = line[cindex].mChar;
-							if (c == '\t')
-							{
-								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-								width = x - cx;
-							}
-							else
-							{
-								char buf2[2];
-								buf2[0] = line[cindex].mChar;
-								buf2[1] = '\0';
-								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
-							}
+							auto next = std::min(cindex + UTF8CharLength(line.GetChar(cindex)), (int)line.size());
+							width = layout.mX[next] - cx;
 						}
 						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
 						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
@@ -1009,36 +975,24 @@ void TextEditor::Render()
 			}
 
 			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
-			ImVec2 bufferOffset;
-
-			for (int i = 0; i < line.size();)
+			// runs of one color are drawn straight from the line's bytes
+			const char* text = line.mChars.data();
+			for (auto& run : layout.mRuns)
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
-
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
+				const ImVec2 offset(textScreenPos.x + run.mX, textScreenPos.y);
+				drawList->AddText(offset, GetGlyphColor(run.mAttribute), text + run.mStart, text + run.mEnd);
+			}
 
-				if (glyph.mChar == '\t')
+			if (mShowWhitespaces)
+			{
+				const auto s = ImGui::GetFontSize();
+				const auto y = textScreenPos.y + s * 0.5f;
+				for (auto i : layout.mWhitespace)
 				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-					++i;
-
-					if (mShowWhitespaces)
+					if (line.GetChar(i) == '\t')
 					{
-						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x1 = textScreenPos.x + layout.mX[i] + 1.0f;
+						const auto x2 = textScreenPos.x + layout.mX[i + 1] - 1.0f;
 						const ImVec2 p1(x1, y);
 						const ImVec2 p2(x2, y);
 						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
@@ -1047,33 +1001,12 @@ void TextEditor::Render()
 						drawList->AddLine(p2, p3, 0x90909090);
 						drawList->AddLine(p2, p4, 0x90909090);
 					}
-				}
-				else if (glyph.mChar == ' ')
-				{
-					if (mShowWhitespaces)
+					else
 					{
-						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x = textScreenPos.x + layout.mX[i] + mSpaceSize * 0.5f;
 						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
 					}
-					bufferOffset.x += spaceSize;
-					i++;
 				}
-				else
-				{
-					auto l = UTF8CharLength(glyph.mChar);
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
-				}
-				++columnNo;
-			}
-
-			if (!mLineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
 			}
 
 			++lineNo;
@@ -1128,6 +1061,10 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	if (!mIgnoreImGuiChild)
 		ImGui::BeginChild(aTitle, aSize, aBorder, ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_NoMove);
 
+	// before the inputs, they measure text too
+	UpdateLayoutMetrics();
+	TrimLineLayouts();
+
 	if (mHandleKeyboardInputs)
 	{
 		HandleKeyboardInputs();
@@ -1154,21 +1091,26 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 
 void TextEditor::SetText(const std::string& aText)
 {
-	mLines.clear();
-	mLines.emplace_back(Line());
-	for (auto chr : aText)
+	std::vector<Line> lines;
+	size_t start = 0;
+	for (;;)
 	{
-		if (chr == '\r')
-		{
-			// ignore the carriage return character
-		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
-		else
-		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
-		}
+		auto end = aText.find('\n', start);
+		if (end == std::string::npos)
+			end = aText.size();
+
+		lines.emplace_back();
+		auto& line = lines.back();
+		line.mChars.assign(aText, start, end - start);
+		// ignore the carriage return character
+		line.mChars.erase(std::remove(line.mChars.begin(), line.mChars.end(), '\r'), line.mChars.end());
+		line.mAttributes.resize(line.mChars.size());
+
+		if (end == aText.size())
+			break;
+		start = end + 1;
 	}
+	mLines.assign(std::move(lines));
 
 	mTextChanged = true;
 	mScrollToTop = true;
@@ -1181,25 +1123,14 @@ void TextEditor::SetText(const std::string& aText)
 
 void TextEditor::SetTextLines(const std::vector<std::string>& aLines)
 {
-	mLines.clear();
+	std::vector<Line> lines(std::max((size_t)1, aLines.size()));
 
-	if (aLines.empty())
-	{
-		mLines.emplace_back(Line());
-	}
-	else
+	for (size_t i = 0; i < aLines.size(); ++i)
 	{
-		mLines.resize(aLines.size());
-
-		for (size_t i = 0; i < aLines.size(); ++i)
-		{
-			const std::string& aLine = aLines[i];
-
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
-		}
+		lines[i].mChars = aLines[i];
+		lines[i].mAttributes.resize(aLines[i].size());
 	}
+	mLines.assign(std::move(lines));
 
 	mTextChanged = true;
 	mScrollToTop = true;
@@ -1253,16 +1184,16 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				{
 					if (!line.empty())
 					{
-						if (line.front().mChar == '\t')
+						if (line.GetChar(0) == '\t')
 						{
-							line.erase(line.begin());
+							line.Erase(0, 1);
 							modified = true;
 						}
 						else
 						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							for (int j = 0; j < mTabSize && !line.empty() && line.GetChar(0) == ' '; j++)
 							{
-								line.erase(line.begin());
+								line.Erase(0, 1);
 								modified = true;
 							}
 						}
@@ -1270,7 +1201,8 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				}
 				else
 				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
+					const char tab = '\t';
+					line.Insert(0, &tab, &tab + 1, (Attribute)PaletteIndex::Background);
 					modified = true;
 				}
 			}
@@ -1301,6 +1233,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				AddUndo(u);
 
 				mTextChanged = true;
+				Colorize(start.mLine, rangeEnd.mLine - start.mLine + 1);
 
 				EnsureCursorVisible();
 			}
@@ -1328,13 +1261,17 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 		auto& newLine = mLines[coord.mLine + 1];
 
 		if (mLanguageDefinition.mAutoIndentation)
-			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
+		{
+			size_t indent = 0;
+			while (indent < line.size() && isascii(line.GetChar(indent)) && isblank(line.GetChar(indent)))
+				++indent;
+			newLine.Insert(0, line, 0, indent);
+		}
 
 		const size_t whitespaceSize = newLine.size();
 		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
+		newLine.Insert(newLine.size(), line, cindex, line.size());
+		line.Erase(cindex, line.size());
 		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
 		u.mAdded = (char)aChar;
 	}
@@ -1350,20 +1287,18 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
 			if (mOverwrite && cindex < (int)line.size())
 			{
-				auto d = UTF8CharLength(line[cindex].mChar);
+				auto d = UTF8CharLength(line.GetChar(cindex));
 
 				u.mRemovedStart = mState.mCursorPosition;
 				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
-				}
+				d = std::min(d, (int)line.size() - cindex);
+				u.mRemoved.append(line.mChars, cindex, d);
+				line.Erase(cindex, cindex + d);
 			}
 
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+			line.Insert(cindex, buf, buf + e);
+			cindex += e;
 			u.mAdded = buf;
 
 			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
@@ -1390,6 +1325,8 @@ void TextEditor::SetReadOnly(bool aValue)
 
 void TextEditor::SetColorizerEnable(bool aValue)
 {
+	if (mColorizerEnabled != aValue)
+		++mLayoutGeneration;
 	mColorizerEnabled = aValue;
 }
 
@@ -1457,7 +1394,10 @@ void TextEditor::SetSelection(const Coordinates& aStart, const Coordinates& aEnd
 
 void TextEditor::SetTabSize(int aValue)
 {
-	mTabSize = std::max(0, std::min(32, aValue));
+	aValue = std::max(0, std::min(32, aValue));
+	if (mTabSize != aValue)
+		++mLayoutGeneration;
+	mTabSize = aValue;
 }
 
 void TextEditor::InsertText(const std::string& aValue)
@@ -1584,7 +1524,7 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			{
 				if ((int)mLines.size() > line)
 				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+					while (cindex > 0 && IsUTFSequence(mLines[line].GetChar(cindex)))
 						--cindex;
 				}
 			}
@@ -1645,7 +1585,7 @@ void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 		}
 		else
 		{
-			cindex += UTF8CharLength(line[cindex].mChar);
+			cindex += UTF8CharLength(line.GetChar(cindex));
 			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
 			if (aWordMode)
 				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
@@ -1788,7 +1728,7 @@ void TextEditor::Delete()
 			Advance(u.mRemovedEnd);
 
 			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
+			line.Insert(line.size(), nextLine, 0, nextLine.size());
 			RemoveLine(pos.mLine + 1);
 		}
 		else
@@ -1798,9 +1738,8 @@ void TextEditor::Delete()
 			u.mRemovedEnd.mColumn++;
 			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
 
-			auto d = UTF8CharLength(line[cindex].mChar);
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+			auto d = UTF8CharLength(line.GetChar(cindex));
+			line.Erase(cindex, std::min(cindex + d, (int)line.size()));
 		}
 
 		mTextChanged = true;
@@ -1847,12 +1786,12 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
 			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+			prevLine.Insert(prevLine.size(), line, 0, line.size());
 
-			ErrorMarkers etmp;
-			for (auto& i : mErrorMarkers)
-				etmp.insert(ErrorMarkers::value_type(i.first - 1 == mState.mCursorPosition.mLine ? i.first - 1 : i.first, i.second));
-			mErrorMarkers = std::move(etmp);
+			// an error on the joined line stays with it
+			auto error = mErrorMarkers.find(mState.mCursorPosition.mLine + 1);
+			if (error != nullptr && mErrorMarkers.find(mState.mCursorPosition.mLine) == nullptr)
+				mErrorMarkers.set(mState.mCursorPosition.mLine, *error);
 
 			RemoveLine(mState.mCursorPosition.mLine);
 			--mState.mCursorPosition.mLine;
@@ -1863,20 +1802,21 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto cindex = GetCharacterIndex(pos) - 1;
 			auto cend = cindex + 1;
-			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
+			while (cindex > 0 && IsUTFSequence(line.GetChar(cindex)))
 				--cindex;
 
-			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
+			//if (cindex > 0 && UTF8CharLength(line.GetChar(cindex)) > 1)
 			//	--cindex;
 
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
 			--u.mRemovedStart.mColumn;
 			--mState.mCursorPosition.mColumn;
 
-			while (cindex < line.size() && cend-- > cindex)
+			cend = std::min(cend, (int)line.size());
+			if (cindex < cend)
 			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
+				u.mRemoved.append(line.mChars, cindex, cend - cindex);
+				line.Erase(cindex, cend);
 			}
 		}
 
@@ -1916,11 +1856,8 @@ void TextEditor::Copy()
 	{
 		if (!mLines.empty())
 		{
-			std::string str;
 			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
-				str.push_back(g.mChar);
-			ImGui::SetClipboardText(str.c_str());
+			ImGui::SetClipboardText(line.mChars.c_str());
 		}
 	}
 }
@@ -2100,14 +2037,7 @@ std::vector<std::string> TextEditor::GetTextLines() const
 
 	for (auto& line : mLines)
 	{
-		std::string text;
-
-		text.resize(line.size());
-
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
-
-		result.emplace_back(std::move(text));
+		result.emplace_back(line.mChars);
 	}
 
 	return result;
@@ -2137,6 +2067,8 @@ void TextEditor::Colorize(int aFromLine, int aLines)
 	mColorRangeMax = std::max(mColorRangeMax, toLine);
 	mColorRangeMin = std::max(0, mColorRangeMin);
 	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
+	mCommentRangeMin = std::min(mCommentRangeMin, std::max(0, aFromLine));
+	mCommentRangeMax = std::max(mCommentRangeMax, toLine);
 	mCheckComments = true;
 }
 
@@ -2145,7 +2077,6 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 	if (mLines.empty() || aFromLine >= aToLine)
 		return;
 
-	std::string buffer;
 	std::cmatch results;
 	std::string id;
 
@@ -2157,16 +2088,13 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 		if (line.empty())
 			continue;
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
-		}
+		// the tokenizer reads the line's own bytes, only the colors are reset
+		for (auto& attribute : line.mAttributes)
+			attribute &= ~ColorMask;
+		line.Touch();
 
-		const char* bufferBegin = &buffer.front();
-		const char* bufferEnd = bufferBegin + buffer.size();
+		const char* bufferBegin = line.mChars.data();
+		const char* bufferEnd = bufferBegin + line.size();
 
 		auto last = bufferEnd;
 
@@ -2220,7 +2148,7 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 					if (!mLanguageDefinition.mCaseSensitive)
 						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
 
-					if (!line[first - bufferBegin].mPreprocessor)
+					if (!(line.mAttributes[first - bufferBegin] & PreprocessorFlag))
 					{
 						if (mLanguageDefinition.mKeywords.count(id) != 0)
 							token_color = PaletteIndex::Keyword;
@@ -2236,8 +2164,9 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 					}
 				}
 
+				auto attribute = line.mAttributes.begin() + (token_begin - bufferBegin);
 				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+					attribute[j] = (attribute[j] & ~ColorMask) | (Attribute)token_color;
 
 				first = token_end;
 			}
@@ -2252,123 +2181,31 @@ void TextEditor::ColorizeInternal()
 
 	if (mCheckComments)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = mLines[currentLine];
-
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
-
-			concatenate = false;
-
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
-
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
-
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
-
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
-
-				if (withinString)
-				{
-					line[currentIndex].mMultiLineComment = inComment;
-
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
-				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
-
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
-
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		// Rescan from the first edited line. Past the last one, a line that
+		// starts in the same state as before scans the same as before, and so
+		// does everything after it.
+		int first = std::min(mCommentRangeMin, (int)mLines.size() - 1);
+		int current = first;
+		LineState state = current > 0 ? mLines[current].mEnterState : LineState();
+		for (; current < (int)mLines.size(); ++current)
+		{
+			auto& line = mLines[current];
+			if (current > first && current >= mCommentRangeMax && line.mEnterState == state)
+				break;
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+			line.mEnterState = state;
+			state = ScanLineComments(line, state);
+		}
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
-				{
-					currentIndex = 0;
-					++currentLine;
-				}
-			}
-			else
-			{
-				currentIndex = 0;
-				++currentLine;
-			}
+		// a directive continued onto more lines changes how their identifiers color
+		if (current > mCommentRangeMax)
+		{
+			mColorRangeMin = std::min(mColorRangeMin, first);
+			mColorRangeMax = std::max(mColorRangeMax, current);
 		}
+
+		mCommentRangeMin = std::numeric_limits<int>::max();
+		mCommentRangeMax = 0;
 		mCheckComments = false;
 	}
 
@@ -2388,33 +2225,186 @@ void TextEditor::ColorizeInternal()
 	}
 }
 
-float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
+TextEditor::LineState TextEditor::ScanLineComments(Line& aLine, LineState aState) const
 {
-	auto& line = mLines[aFrom.mLine];
-	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-	int colIndex = GetCharacterIndex(aFrom);
-	for (size_t it = 0u; it < line.size() && it < colIndex; )
+	if (!aState.mContinued)
 	{
-		if (line[it].mChar == '\t')
+		aState.mSingleLineComment = false;
+		aState.mPreprocessor = false;
+		aState.mFirstChar = true;
+	}
+
+	auto& chars = aLine.mChars;
+	auto& startStr = mLanguageDefinition.mCommentStart;
+	auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
+	auto& endStr = mLanguageDefinition.mCommentEnd;
+	const int size = (int)aLine.size();
+
+	for (int i = 0; i < size; )
+	{
+		auto c = aLine.GetChar(i);
+		auto d = UTF8CharLength(c);
+
+		if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+			aState.mFirstChar = false;
+
+		if (aState.mString)
 		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-			++it;
+			// a doubled quote or an escaped character stays in the string
+			if (c == '\"' && i + 1 < size && aLine.GetChar(i + 1) == '\"')
+				d = 2;
+			else if (c == '\"')
+				aState.mString = false;
+			else if (c == '\\')
+				d = 2;
 		}
 		else
 		{
-			auto d = UTF8CharLength(line[it].mChar);
-			char tempCString[7];
-			int i = 0;
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].mChar;
+			if (aState.mFirstChar && c == mLanguageDefinition.mPreprocChar)
+				aState.mPreprocessor = true;
+
+			if (c == '\"')
+				aState.mString = true;
+			else if (singleStartStr.size() > 0 && chars.compare(i, singleStartStr.size(), singleStartStr) == 0)
+				aState.mSingleLineComment = true;
+			else if (!aState.mSingleLineComment && chars.compare(i, startStr.size(), startStr) == 0)
+				aState.mMultiLineComment = true;
+		}
+
+		// the glyph, and the rest of its UTF-8 sequence or escape
+		const Attribute flags =
+			(aState.mMultiLineComment ? MultiLineCommentFlag : 0) |
+			(aState.mSingleLineComment ? CommentFlag : 0) |
+			(aState.mPreprocessor ? PreprocessorFlag : 0);
+		for (int j = i; j < i + d && j < size; ++j)
+			aLine.mAttributes[j] = (aLine.mAttributes[j] & ColorMask) | flags;
 
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+		// the end marker is still part of the comment
+		if (!aState.mString && i + 1 >= (int)endStr.size() &&
+			chars.compare(i + 1 - endStr.size(), endStr.size(), endStr) == 0)
+			aState.mMultiLineComment = false;
+
+		i += d;
+	}
+
+	aLine.Touch();
+
+	aState.mContinued = size > 0 && aLine.GetChar(size - 1) == '\\';
+	if (!aState.mContinued)
+	{
+		aState.mSingleLineComment = false;
+		aState.mPreprocessor = false;
+		aState.mFirstChar = true;
+	}
+	return aState;
+}
+
+float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
+{
+	auto& layout = GetLineLayout(mLines[aFrom.mLine]);
+	auto index = std::max(0, std::min(GetCharacterIndex(aFrom), (int)layout.mX.size() - 1));
+	return layout.mX[index];
+}
+
+void TextEditor::UpdateLayoutMetrics()
+{
+	auto font = ImGui::GetFont();
+	auto fontSize = ImGui::GetFontSize();
+	if (font == mLayoutFont && fontSize == mLayoutFontSize)
+		return;
+
+	mLayoutFont = font;
+	mLayoutFontSize = fontSize;
+	++mLayoutGeneration;
+
+	mSpaceSize = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	for (int i = 0; i < 10; i++)
+	{
+		char digit[2] = { char('0' + i), '\0' };
+		mDigitAdvance[i] = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, digit, nullptr, nullptr).x;
+	}
+	mCharAdvance.x = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+}
+
+void TextEditor::TrimLineLayouts()
+{
+	// only the lines drawn last frame are likely to be drawn again
+	++mLayoutFrame;
+	for (auto it = mLineLayouts.begin(); it != mLineLayouts.end(); )
+	{
+		if (mLayoutFrame - it->second.mLastUsed > 1)
+			it = mLineLayouts.erase(it);
+		else
+			++it;
+	}
+}
+
+const TextEditor::LineLayout& TextEditor::GetLineLayout(const Line& aLine) const
+{
+	auto& cached = mLineLayouts[aLine.mRevision];
+	cached.mLastUsed = mLayoutFrame;
+	if (cached.mGeneration == mLayoutGeneration)
+		return cached;
+
+	LineLayout* layout = &cached;
+	*layout = LineLayout();
+	layout->mGeneration = mLayoutGeneration;
+	layout->mLastUsed = mLayoutFrame;
+	layout->mX.resize(aLine.size() + 1);
+
+	const char* text = aLine.mChars.data();
+	const float tabSize = float(mTabSize) * mSpaceSize;
+	float x = 0.0f;
+	int column = 0;
+	for (size_t i = 0; i < aLine.size(); ++column)
+	{
+		auto c = aLine.GetChar(i);
+		if (c == '\t' || c == ' ')
+		{
+			layout->mWhitespace.push_back((int)i);
+			layout->mX[i++] = x;
+			if (c == '\t')
+			{
+				x = (1.0f + std::floor((1.0f + x) / tabSize)) * tabSize;
+				column = (column / mTabSize) * mTabSize + mTabSize - 1;
+			}
+			else
+				x += mSpaceSize;
+			continue;
 		}
+
+		// the bits GetGlyphColor looks at, so a run only ends where the color does
+		Attribute attribute = aLine.mAttributes[i];
+		if (!mColorizerEnabled)
+			attribute = 0;
+		else if (attribute & CommentFlag)
+			attribute = CommentFlag;
+		else if (attribute & MultiLineCommentFlag)
+			attribute = MultiLineCommentFlag;
+
+		auto& runs = layout->mRuns;
+		if (runs.empty() || runs.back().mEnd != (int)i || runs.back().mAttribute != attribute)
+			runs.push_back({ (int)i, (int)i, x, attribute });
+
+		auto end = std::min(i + UTF8CharLength(c), aLine.size());
+		auto width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, text + i, text + end, nullptr).x;
+		for (; i < end; ++i)
+			layout->mX[i] = x;
+		x += width;
+		runs.back().mEnd = (int)end;
 	}
+	layout->mX[aLine.size()] = x;
+	layout->mColumns = column;
 
-	return distance;
+	return *layout;
+}
+
+float TextEditor::GetNumberWidth(const char* aText) const
+{
+	float width = 0.0f;
+	for (; *aText != '\0'; ++aText)
+		width += *aText >= '0' && *aText <= '9' ? mDigitAdvance[*aText - '0'] : mSpaceSize;
+	return width;
 }
 
 void TextEditor::EnsureCursorVisible()
@@ -2734,6 +2724,189 @@ static bool TokenizeCStylePunctuation(const char* in_begin, const char* in_end,
 	return false;
 }
 
+// Character classes for the GLSL tokenizer. One table lookup per character
+// decides what a token is, instead of trying a regex per token kind.
+enum GLSLCharClass : unsigned char
+{
+	GLSLOther,
+	GLSLBlank,
+	GLSLLetter,		// letters and '_'
+	GLSLDigit,
+	GLSLDot,
+	GLSLPunctuation,
+	GLSLQuote,
+	GLSLHash
+};
+
+struct GLSLCharTable
+{
+	unsigned char mClass[256];
+
+	GLSLCharTable()
+	{
+		for (int c = 0; c < 256; c++)
+			mClass[c] = GLSLOther;
+
+		for (int c = 'a'; c <= 'z'; c++)
+			mClass[c] = GLSLLetter;
+		for (int c = 'A'; c <= 'Z'; c++)
+			mClass[c] = GLSLLetter;
+		for (int c = '0'; c <= '9'; c++)
+			mClass[c] = GLSLDigit;
+		for (const char* p = "[]{}()!%^&*-+=~|<>?:/;,"; *p; p++)
+			mClass[(unsigned char)*p] = GLSLPunctuation;
+
+		mClass['_'] = GLSLLetter;
+		mClass[' '] = GLSLBlank;
+		mClass['\t'] = GLSLBlank;
+		mClass['.'] = GLSLDot;
+		mClass['"'] = GLSLQuote;
+		mClass['#'] = GLSLHash;
+	}
+
+	unsigned char operator[](char c) const { return mClass[(unsigned char)c]; }
+};
+
+static const GLSLCharTable sGLSLChars;
+
+static bool IsGLSLHexDigit(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Decimal, octal and hex integers with an optional u suffix, floats with an
+// optional exponent and f or lf suffix. The sign is left to the punctuation.
+static const char* TokenizeGLSLNumber(const char* p, const char* in_end)
+{
+	if (p + 2 < in_end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && IsGLSLHexDigit(p[2]))
+	{
+		p += 2;
+		while (p < in_end && IsGLSLHexDigit(*p))
+			p++;
+		if (p < in_end && (*p == 'u' || *p == 'U'))
+			p++;
+		return p;
+	}
+
+	bool isFloat = false;
+
+	while (p < in_end && sGLSLChars[*p] == GLSLDigit)
+		p++;
+
+	if (p < in_end && *p == '.')
+	{
+		isFloat = true;
+		p++;
+		while (p < in_end && sGLSLChars[*p] == GLSLDigit)
+			p++;
+	}
+
+	// only an exponent with digits, "1e" is a number and an identifier
+	if (p < in_end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		if (e < in_end && (*e == '+' || *e == '-'))
+			e++;
+		if (e < in_end && sGLSLChars[*e] == GLSLDigit)
+		{
+			isFloat = true;
+			p = e;
+			while (p < in_end && sGLSLChars[*p] == GLSLDigit)
+				p++;
+		}
+	}
+
+	if (isFloat)
+	{
+		if (p < in_end && (*p == 'f' || *p == 'F'))
+			p++;
+		else if (p + 1 < in_end && ((p[0] == 'l' && p[1] == 'f') || (p[0] == 'L' && p[1] == 'F')))
+			p += 2;
+	}
+	else if (p < in_end && (*p == 'u' || *p == 'U'))
+		p++;
+
+	return p;
+}
+
+static bool TokenizeGLSL(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, TextEditor::PaletteIndex& paletteIndex)
+{
+	while (in_begin < in_end && sGLSLChars[*in_begin] == GLSLBlank)
+		in_begin++;
+
+	out_begin = in_begin;
+	out_end = in_end;
+	paletteIndex = TextEditor::PaletteIndex::Default;
+
+	if (in_begin == in_end)
+		return true;
+
+	const char* p = in_begin;
+	switch (sGLSLChars[*p])
+	{
+	case GLSLLetter:
+		p++;
+		while (p < in_end && (sGLSLChars[*p] == GLSLLetter || sGLSLChars[*p] == GLSLDigit))
+			p++;
+		paletteIndex = TextEditor::PaletteIndex::Identifier;
+		break;
+
+	case GLSLDigit:
+		p = TokenizeGLSLNumber(p, in_end);
+		paletteIndex = TextEditor::PaletteIndex::Number;
+		break;
+
+	case GLSLDot:
+		// ".5" is a number, any other dot a swizzle or member access
+		if (p + 1 < in_end && sGLSLChars[p[1]] == GLSLDigit)
+		{
+			p = TokenizeGLSLNumber(p, in_end);
+			paletteIndex = TextEditor::PaletteIndex::Number;
+		}
+		else
+		{
+			p++;
+			paletteIndex = TextEditor::PaletteIndex::Punctuation;
+		}
+		break;
+
+	case GLSLPunctuation:
+		p++;
+		paletteIndex = TextEditor::PaletteIndex::Punctuation;
+		break;
+
+	case GLSLHash:
+		// the directive name, the rest of the line is colored by its preprocessor flag
+		p++;
+		while (p < in_end && sGLSLChars[*p] == GLSLBlank)
+			p++;
+		while (p < in_end && sGLSLChars[*p] == GLSLLetter)
+			p++;
+		paletteIndex = TextEditor::PaletteIndex::Preprocessor;
+		break;
+
+	case GLSLQuote:
+		// GLSL has no strings, but #include "file" does
+		if (TokenizeCStyleString(in_begin, in_end, out_begin, out_end))
+		{
+			paletteIndex = TextEditor::PaletteIndex::String;
+			return true;
+		}
+		p++;
+		break;
+
+	default:
+		// anything else, UTF-8 included, goes as one uncolored run
+		p++;
+		while (p < in_end && sGLSLChars[*p] == GLSLOther)
+			p++;
+		break;
+	}
+
+	out_end = p;
+	return true;
+}
+
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
 {
 	static bool inited = false;
@@ -2900,15 +3073,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
 			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.mTokenize = TokenizeGLSL;
 
 		langDef.mCommentStart = "/*";
 		langDef.mCommentEnd = "*/";
@@ -3,12 +3,16 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
 #include <regex>
 #include "imgui.h"
+#include "LineRope.h"
+#include "LineMarkers.h"
 
 class TextEditor
 {
@@ -134,21 +138,111 @@ public:
 	typedef std::array<ImU32, (unsigned)PaletteIndex::Max> Palette;
 	typedef uint8_t Char;
 
-	struct Glyph
+	// What the colorizer found for a byte of a line: its palette index in the
+	// low bits, the flags the comment scan sets above them.
+	typedef uint8_t Attribute;
+	static constexpr Attribute ColorMask = 0x1f;
+	static constexpr Attribute CommentFlag = 0x20;
+	static constexpr Attribute MultiLineCommentFlag = 0x40;
+	static constexpr Attribute PreprocessorFlag = 0x80;
+	static_assert((unsigned)PaletteIndex::Max <= ColorMask + 1u, "palette index does not fit the attribute bits");
+
+	// Where the comment scan stands at the start of a line. Kept with every
+	// line so an edit only rescans from the edited line down to the first line
+	// whose start state comes out unchanged.
+	struct LineState
 	{
-		Char mChar;
-		PaletteIndex mColorIndex = PaletteIndex::Default;
-		bool mComment : 1;
-		bool mMultiLineComment : 1;
-		bool mPreprocessor : 1;
-
-		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex),
-			mComment(false), mMultiLineComment(false), mPreprocessor(false) {
+		bool mMultiLineComment = false;
+		bool mString = false;
+		bool mContinued = false;			// the line before ended with '\'
+		bool mSingleLineComment = false;	// carried over only when continued
+		bool mPreprocessor = false;			// carried over only when continued
+		bool mFirstChar = true;				// nothing but whitespace and the preprocessor char so far
+
+		bool operator ==(const LineState& o) const
+		{
+			return
+				mMultiLineComment == o.mMultiLineComment &&
+				mString == o.mString &&
+				mContinued == o.mContinued &&
+				mSingleLineComment == o.mSingleLineComment &&
+				mPreprocessor == o.mPreprocessor &&
+				mFirstChar == o.mFirstChar;
+		}
+
+		bool operator !=(const LineState& o) const { return !(*this == o); }
+	};
+
+	// Where the characters of a line land, from the left of the text. Built
+	// when the line is drawn and kept by the editor, under the line's revision,
+	// until the line changes, or the font, the tab size or the colorizer
+	// setting do.
+	struct LineLayout
+	{
+		struct Run
+		{
+			int mStart, mEnd;		// bytes of the line
+			float mX;
+			Attribute mAttribute;	// reduced to what picks the color
+		};
+
+		unsigned mGeneration = 0;
+		unsigned mLastUsed = 0;		// the last frame that asked for it
+		int mColumns = 0;
+		std::vector<float> mX;			// left edge of every byte, then the end of the line
+		std::vector<Run> mRuns;			// text between whitespace, split where the color changes
+		std::vector<int> mWhitespace;	// tabs and spaces, for drawing them
+	};
+
+	// A line is its UTF-8 bytes plus one attribute per byte, two bytes a
+	// character, and its text can go to the tokenizer or out as it is.
+	struct Line
+	{
+		std::string mChars;
+		std::vector<Attribute> mAttributes;
+		LineState mEnterState;
+
+		// New with every change, and copied along with the line, so it stands
+		// for the contents wherever the line is. Snapshots may share the line,
+		// which is why the layout isn't kept in it.
+		uint64_t mRevision = NextRevision();
+
+		void Touch() { mRevision = NextRevision(); }
+		static uint64_t NextRevision()
+		{
+			static std::atomic<uint64_t> sRevision(0);
+			return ++sRevision;
+		}
+
+		size_t size() const { return mChars.size(); }
+		bool empty() const { return mChars.empty(); }
+		Char GetChar(size_t aIndex) const { return (Char)mChars[aIndex]; }
+		PaletteIndex GetColorIndex(size_t aIndex) const { return (PaletteIndex)(mAttributes[aIndex] & ColorMask); }
+
+		void Insert(size_t aIndex, const char* aBegin, const char* aEnd, Attribute aAttribute = 0)
+		{
+			mChars.insert(aIndex, aBegin, aEnd - aBegin);
+			mAttributes.insert(mAttributes.begin() + aIndex, aEnd - aBegin, aAttribute);
+			Touch();
+		}
+
+		// characters [aFirst, aLast) of aFrom, with their attributes
+		void Insert(size_t aIndex, const Line& aFrom, size_t aFirst, size_t aLast)
+		{
+			mChars.insert(aIndex, aFrom.mChars, aFirst, aLast - aFirst);
+			mAttributes.insert(mAttributes.begin() + aIndex, aFrom.mAttributes.begin() + aFirst, aFrom.mAttributes.begin() + aLast);
+			Touch();
+		}
+
+		void Erase(size_t aFirst, size_t aLast)
+		{
+			mChars.erase(aFirst, aLast - aFirst);
+			mAttributes.erase(mAttributes.begin() + aFirst, mAttributes.begin() + aLast);
+			Touch();
 		}
 	};
 
-	typedef std::vector<Glyph> Line;
-	typedef std::vector<Line> Lines;
+	typedef LineRope<Line> Lines;
 
 	struct LanguageDefinition
 	{
@@ -193,8 +287,8 @@ public:
 	const Palette& GetPalette() const { return mPaletteBase; }
 	void SetPalette(const Palette& aValue);
 
-	void SetErrorMarkers(const ErrorMarkers& aMarkers) { mErrorMarkers = aMarkers; }
-	void SetBreakpoints(const Breakpoints& aMarkers) { mBreakpoints = aMarkers; }
+	void SetErrorMarkers(const ErrorMarkers& aMarkers);
+	void SetBreakpoints(const Breakpoints& aMarkers);
 
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
 	void SetText(const std::string& aText);
@@ -207,6 +301,10 @@ public:
 	std::string GetCurrentLineText()const;
 
 	int GetTotalLines() const { return (int)mLines.size(); }
+
+	// The lines as they are now, in O(1). The snapshot shares them with the
+	// editor until either side changes one, and may be read on another thread.
+	Lines GetSnapshot() const { return mLines; }
 	bool IsOverwrite() const { return mOverwrite; }
 
 	void SetReadOnly(bool aValue);
@@ -317,6 +415,7 @@ private:
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
+	LineState ScanLineComments(Line& aLine, LineState aState) const;
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -344,7 +443,11 @@ private:
 	void DeleteSelection();
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
-	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	ImU32 GetGlyphColor(Attribute aAttribute) const;
+	void UpdateLayoutMetrics();
+	void TrimLineLayouts();
+	const LineLayout& GetLineLayout(const Line& aLine) const;
+	float GetNumberWidth(const char* aText) const;
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
@@ -368,6 +471,7 @@ private:
 	int  mLeftMargin;
 	bool mCursorPositionChanged;
 	int mColorRangeMin, mColorRangeMax;
+	int mCommentRangeMin, mCommentRangeMax;	// lines edited since the last comment scan
 	SelectionMode mSelectionMode;
 	bool mHandleKeyboardInputs;
 	bool mHandleMouseInputs;
@@ -380,11 +484,19 @@ private:
 	RegexList mRegexList;
 
 	bool mCheckComments;
-	Breakpoints mBreakpoints;
-	ErrorMarkers mErrorMarkers;
+	LineMarkers<bool> mBreakpoints;			// by line number, from 1
+	LineMarkers<std::string> mErrorMarkers;
 	ImVec2 mCharAdvance;
+
+	// what the line layouts are built for, a change starts a new generation
+	ImFont* mLayoutFont;
+	float mLayoutFontSize;
+	unsigned mLayoutGeneration;
+	unsigned mLayoutFrame;
+	mutable std::unordered_map<uint64_t, LineLayout> mLineLayouts;	// by line revision
+	float mSpaceSize;
+	float mDigitAdvance[10];
 	Coordinates mInteractiveStart, mInteractiveEnd;
-	std::string mLineBuffer;
 	uint64_t mStartTime;
 
 	float mLastClick;
@@ -0,0 +1,44 @@
+#pragma once
+#include <glad/glad.h>
+
+// Averages the image pass over many frames, for shaders that take one noisy
+// sample per frame such as path tracers. Every frame is blended into an RGBA32F
+// target with weight 1/(n+1), so the target always holds the mean of the n
+// samples so far; shaders see n as iSampleCount to pick their random sequence.
+// Starts over when the mouse, the size or the render graph changes, and stops
+// drawing altogether once the sample target is reached.
+struct Accumulator
+{
+	bool enabled = false;
+	int sampleTarget = 1024;	// 0 never stops
+
+	void clear();
+
+	// Call before drawing a frame. Returns false when no sample should be drawn,
+	// the last image is then presented as it is.
+	bool begin(int width, int height, const float mouse[4], unsigned int graphVersion);
+
+	// Around the image pass only, the buffers must not blend into their targets.
+	// Binds the accumulation target and blends the sample into it.
+	void beginSample();
+	void end();	// after the sample is drawn
+
+	GLuint getFramebuffer() const { return fbo; }
+	void present(GLuint framebuffer, int width, int height);
+
+	void reset() { restart(); }
+	int getSampleCount() const { return samples; }
+	bool isConverged() const { return sampleTarget > 0 && samples >= sampleTarget; }
+
+private:
+	void restart();	// samples back to 0, and the target cleared
+
+	GLuint texture = 0;
+	GLuint fbo = 0;
+	int width = 0;
+	int height = 0;
+
+	int samples = 0;
+	float lastMouse[4] = {};
+	unsigned int lastGraphVersion = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <glad/glad.h>
+#include <mappedFile.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Stands in for a live input when there is no file at hand: a pair of tones
+// with a 2 Hz pulse, enough to see a shader react.
+const char* const AudioTestSignalName = "Audio Test";
+
+bool isAudioChannelName(const std::string& name);	// .wav files and the test signal
+
+// A channel showing what a piece of audio sounds like at the shader's iTime,
+// as the 512x2 texture shadertoy.com uses: the spectrum in the bottom row
+// (y = 0.25), the waveform in the top one (y = 0.75), one byte per texel.
+// The analysis runs on a worker thread and is handed over through a lock-free
+// triple buffer, the render thread only uploads 1 KB when a new one is in.
+// The worker works for the time it expects the next frame to ask for, so at a
+// steady frame rate the texture matches iTime exactly.
+struct AudioChannel
+{
+	static constexpr int TextureWidth = 512;
+
+	~AudioChannel() { close(); }
+
+	// A WAV file (8, 16, 24 or 32 bit PCM, or float) or AudioTestSignalName. Without
+	// a worker every update() analyses on the calling thread, for offline rendering.
+	bool open(const std::string& path, bool useWorker = true);
+	void close();
+
+	// Render thread, once per frame. Returns true when the texture changed.
+	bool update(float time);
+
+	GLuint getTexture() const { return texture; }
+	unsigned int getRevision() const { return revision; }
+
+private:
+	static constexpr int fftSize = 2048;
+
+	struct Analysis
+	{
+		unsigned char texels[2 * TextureWidth];
+	};
+
+	bool openWav(const std::string& path);
+	float getSample(long long frame) const;	// channels mixed down, 0 outside the file
+	void analyse(double time, Analysis& out);
+	void workerLoop();
+	void upload(const Analysis& a);
+
+	// source
+	MappedFile file;
+	const unsigned char* samples = nullptr;
+	long long frameCount = 0;
+	int channels = 0;
+	int frameBytes = 0;
+	int bytesPerSample = 0;
+	bool floatSamples = false;
+	bool testSignal = false;
+	int sampleRate = 44100;
+
+	// analysis state, owned by whoever runs analyse()
+	float smoothed[fftSize / 2] = {};
+	double lastAnalysedTime = -1;
+
+	// worker side of the triple buffer: it fills slots[back] and swaps it with
+	// the middle one, the render thread swaps the middle one for its front
+	Analysis slots[3];
+	int back = 0;
+	int front = 1;
+	std::atomic<int> middle{ 2 };	// slot index, freshBit once the worker swapped in a new one
+	static constexpr int freshBit = 4;
+
+	// the worker sleeps until update() moves expectedTime, or close() stops it
+	std::thread worker;
+	std::mutex timeMutex;
+	std::condition_variable timeChanged;
+	bool running = false;
+	double expectedTime = 0.0;
+
+	GLuint texture = 0;
+	unsigned int revision = 0;
+	float lastTime = -1.0f;
+};
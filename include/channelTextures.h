@@ -0,0 +1,31 @@
+#pragma once
+#include <renderGraph.h>
+#include <textureLoader.h>
+#include <audioChannel.h>
+#include <map>
+#include <memory>
+#include <string>
+
+// Requests the image files the passes' channels name and hands each texture to
+// the graph once the loader has it. Audio channels are opened here instead,
+// one analysis per source however many channels read it. Call update() every
+// frame, after the loader's own update, with the time the frame is drawn at.
+struct ChannelTextures
+{
+	// Analyse audio on the calling thread, so each frame gets exactly its time.
+	bool synchronousAudio = false;
+
+	// Files are relative to folder unless absolute.
+	void update(RenderGraph& graph, TextureLoader& loader, const std::string& folder, float time);
+	void clear(TextureLoader& loader);
+
+	bool hasFailed(const TextureLoader& loader, int pass, int channel) const;
+	bool getResidency(const TextureLoader& loader, int pass, int channel, size_t& uploaded, size_t& total) const;
+
+private:
+	int handles[RenderPassCount][ChannelCount] = {
+		{ -1, -1, -1, -1 }, { -1, -1, -1, -1 }, { -1, -1, -1, -1 }, { -1, -1, -1, -1 }, { -1, -1, -1, -1 } };
+	std::string files[RenderPassCount][ChannelCount];
+	std::string audioPaths[RenderPassCount][ChannelCount];
+	std::map<std::string, std::unique_ptr<AudioChannel>> audio;	// by path, null when it failed to open
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>
+#include <shaderLoader.h>
+#include <fullscreenQuad.h>
+#include <gpuTimer.h>
+
+enum UpscaleFilter
+{
+	UpscaleBilinear,
+	UpscaleSharpen,
+	UpscaleFilterCount
+};
+
+const char* getUpscaleFilterName(UpscaleFilter filter);
+
+// Renders the image pass into an offscreen target at a fraction of the output
+// size and scales it back up. The fraction follows the measured GPU time of the
+// image pass so the whole frame stays within a budget: the pass' cost is taken
+// to grow with its pixel count, everything else in the frame as fixed. Timings
+// come back a few frames late, each is matched with the scale its frame used.
+struct DynamicResolution
+{
+	bool enabled = false;
+	float targetMs = 16.6f;
+	float minScale = 0.25f;
+	float maxScale = 1.0f;
+	UpscaleFilter filter = UpscaleBilinear;
+
+	bool init();
+	void clear();
+
+	// Call once per frame after GpuTimer::beginFrame, picks this frame's scale.
+	void update(const GpuTimer& timer, const char* imagePass);
+	float getScale() const { return enabled ? scale : 1.0f; }
+
+	// The offscreen target, reallocated when the output size changes. The image
+	// goes into its lower left renderWidth x renderHeight pixels. 0 for an empty
+	// output size.
+	GLuint getFramebuffer(int width, int height);
+	void getRenderSize(int width, int height, int& renderWidth, int& renderHeight) const;
+
+	// Draws the scaled image over the whole of the output framebuffer.
+	void present(GLuint framebuffer, int width, int height, FullscreenQuad& quad);
+
+private:
+	static constexpr int historySize = 16;
+
+	Shader upscale;
+	GLint sourceSizeLocation = -1;
+	GLint sourceScaleLocation = -1;
+	GLint sharpnessLocation = -1;
+
+	GLuint texture = 0;
+	GLuint fbo = 0;
+	int targetWidth = 0;
+	int targetHeight = 0;
+
+	float scale = 1.0f;
+	float history[historySize] = {};	// scale per frame number, modulo historySize
+	long long lastSampledFrame = -1;
+	double fullScaleMs = 0;	// smoothed cost of the image pass at scale 1
+};
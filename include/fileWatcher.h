@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+template<class T, size_t Capacity>
+struct SpscQueue
+{
+	bool push(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = (t + 1) % Capacity;
+		if (next == head.load(std::memory_order_acquire)) { return false; }
+
+		items[t] = value;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) { return false; }
+
+		value = items[h];
+		head.store((h + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, Capacity> items = {};
+	std::atomic<size_t> head = { 0 };
+	std::atomic<size_t> tail = { 0 };
+};
+
+// Watches a set of files from a background thread (inotify on Linux, a slow
+// stat loop elsewhere). Bursts of writes to the same file are debounced into
+// one change, which the render loop picks up with poll() without any syscall.
+struct FileWatcher
+{
+	bool start(int debounceMs = 100);
+	void stop();
+
+	// Can be called while running, returns the id poll() reports or -1.
+	int addFile(const std::string& path);
+
+	// Render thread only.
+	bool poll(int& fileId) { return changes.pop(fileId); }
+
+private:
+	struct WatchedFile
+	{
+		std::string path;
+		std::string directory;
+		std::string name;
+		std::chrono::steady_clock::time_point due;
+		bool pending = false;
+		long long lastWrite = 0;	// fallback watcher only
+	};
+
+	void threadLoop();
+	void markChanged(const std::string& directory, const std::string& name);
+	int flushDue();
+
+	std::vector<WatchedFile> files;
+	std::mutex mutex;
+	std::thread thread;
+	std::atomic<bool> running = { false };
+	std::chrono::milliseconds debounce = std::chrono::milliseconds(100);
+
+	SpscQueue<int, 256> changes;
+
+	// inotify fd, directory watch descriptors and the fd used to wake the thread up
+	int notifyFd = -1;
+	int wakeFd = -1;
+	std::vector<std::pair<int, std::string>> directoryWatches;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <glad/glad.h>
+#include <renderGraph.h>
+
+// Keeps a copy of the last frame the shaders drew and shows it again while
+// nothing they read has changed, so a paused shader or one that only follows the
+// mouse costs a blit instead of a full redraw. What a program reads comes from
+// RenderGraph::uses(); anything reading iFrame, iTimeDelta or iFrameRate, or a
+// buffer feeding back into itself, is redrawn every frame.
+struct FrameCache
+{
+	bool enabled = true;
+
+	void clear();
+	void invalidate() { valid = false; }
+
+	// Whether the stored frame is what drawing these inputs would give. The
+	// image size is the part of the output the image pass covers.
+	bool isCurrent(RenderGraph& graph, const BuiltinUniformValues& inputs, int width, int height, int imageWidth, int imageHeight) const;
+
+	// Copies the output after drawing and remembers what it was drawn from. The
+	// copy is skipped when the next frame can't be the same.
+	void store(RenderGraph& graph, const BuiltinUniformValues& inputs, GLuint framebuffer, int width, int height, int imageWidth, int imageHeight);
+	void present(GLuint framebuffer);
+
+	long long getReusedFrames() const { return reusedFrames; }
+
+private:
+	static bool isNeverStatic(RenderGraph& graph);
+	bool readsSameInputs(const RenderGraph& graph, const BuiltinUniformValues& inputs) const;
+
+	GLuint texture = 0;
+	GLuint fbo = 0;
+	int width = 0;
+	int height = 0;
+	int imageWidth = 0;
+	int imageHeight = 0;
+
+	bool valid = false;
+	unsigned int graphVersion = 0;
+	BuiltinUniformValues inputs;	// of the last frame drawn, stored or not
+	long long reusedFrames = 0;
+};
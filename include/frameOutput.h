@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <vector>
+
+// Writes RGBA8 pixels as read from GL (rows bottom up) to a binary PPM.
+bool writePPM(const std::string& path, int width, int height, const unsigned char* rgba, size_t stride);
+
+// Writes a PPM one horizontal strip at a time, top strip first, so images too
+// large to hold in memory only ever need a strip of them. Strips are RGBA8 as
+// read from GL, their rows bottom up.
+struct PPMStripWriter
+{
+	bool open(const std::string& path, int width, int height);
+	bool writeStrip(const unsigned char* rgba, size_t stride, int rows);
+	bool close();	// false when a write failed or rows are missing
+
+private:
+	std::ofstream file;
+	int width = 0;
+	int rowsLeft = 0;
+	std::vector<unsigned char> row;
+};
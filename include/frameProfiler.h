@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Splits each frame into named CPU stages and keeps the last historySize frames
+// of every stage, so spikes show up in p95/p99 instead of disappearing in an
+// average. A stage may be entered several times a frame, its times add up.
+struct FrameProfiler
+{
+	static constexpr int historySize = 600;	// 10 s at 60 Hz
+
+	struct Stage
+	{
+		std::string name;
+		std::vector<float> history = std::vector<float>(historySize);
+		float lastMs = 0;
+		float p50 = 0, p95 = 0, p99 = 0, max = 0;
+
+		double frameMs = 0;	// this frame so far
+		std::chrono::steady_clock::time_point start;
+	};
+
+	int addStage(const char* name);
+
+	void beginFrame();
+	void endFrame();
+
+	void begin(int stage) { stages[stage].start = std::chrono::steady_clock::now(); }
+	void end(int stage)
+	{
+		Stage& s = stages[stage];
+		s.frameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s.start).count();
+	}
+
+	const Stage& getFrame() const { return frame; }
+	const std::vector<Stage>& getStages() const { return stages; }
+	int getRecordedFrames() const { return recorded; }
+
+	// One row per recorded frame, oldest first.
+	bool exportCSV(const std::string& path) const;
+	// Percentiles per stage plus the raw samples.
+	bool exportJSON(const std::string& path) const;
+
+	void drawOverlay(bool* open);
+
+private:
+	void updatePercentiles();
+	float getSample(const Stage& s, int age) const;
+
+	std::vector<Stage> stages;
+	Stage frame;	// whole frame, beginFrame to endFrame
+	int next = 0;
+	int recorded = 0;
+	int framesSincePercentiles = 0;
+	int exportCount = 0;
+};
+
+struct ProfileScope
+{
+	ProfileScope(FrameProfiler& profiler, int stage) : profiler(profiler), stage(stage) { profiler.begin(stage); }
+	~ProfileScope() { profiler.end(stage); }
+
+	FrameProfiler& profiler;
+	int stage;
+};
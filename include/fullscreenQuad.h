@@ -0,0 +1,14 @@
+#pragma once
+#include <glad/glad.h>
+
+// The two triangles every pass is drawn with, laid out for resources/vertex.vert.
+struct FullscreenQuad
+{
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ibo = 0;
+
+	void create();
+	void draw();
+	void clear();
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Times passes on the GPU with GL_TIMESTAMP queries. Queries are kept for a few
+// frames and only read once the driver says they are available, so reading them
+// never stalls; a frame whose results are still not in when its slot comes round
+// again is simply skipped. Passes may nest.
+struct GpuTimer
+{
+	struct Pass
+	{
+		std::string name;
+		double lastMs = 0;
+		double averageMs = 0;	// over the last sampleCount frames
+		long long lastFrame = -1;	// frame number lastMs was measured in
+
+		static constexpr int sampleCount = 60;
+		float samples[sampleCount] = {};
+		int sampled = 0;
+		int next = 0;
+	};
+
+	bool init(int frameLatency = 3);
+	void clear();
+
+	void beginFrame();
+	void endFrame();
+
+	void beginPass(const char* name);
+	void endPass();
+
+	// 0 until the first results came back
+	double getFrameMs() const { return frame.averageMs; }
+	double getPassMs(const char* name) const;
+	const std::vector<Pass>& getPasses() const { return passes; }
+	const Pass* findPass(const char* name) const;
+	const Pass& getFrame() const { return frame; }
+
+	// Counts beginFrame calls, results name the frame they belong to with it.
+	long long getFrameNumber() const { return frameNumber; }
+
+private:
+	struct Interval
+	{
+		int pass;	// -1 for the whole frame
+		GLuint begin;
+		GLuint end;
+	};
+
+	struct FrameQueries
+	{
+		std::vector<GLuint> pool;
+		int used = 0;
+		std::vector<Interval> intervals;
+		long long number = 0;
+		bool pending = false;
+	};
+
+	GLuint nextQuery();
+	void resolve(FrameQueries& f);
+	static void addSample(Pass& p, double ms, long long frameNumber);
+
+	std::vector<FrameQueries> frames;
+	int current = 0;
+	long long frameNumber = 0;
+	bool inFrame = false;
+	std::vector<Pass> passes;
+	Pass frame;
+	std::vector<size_t> open;	// intervals begun but not ended
+};
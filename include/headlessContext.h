@@ -0,0 +1,26 @@
+#pragma once
+
+struct GLFWwindow;
+
+// A GL context that needs no window and no display server. With EGL available it
+// uses the surfaceless platform (Mesa) or the first EGL device (NVIDIA), otherwise
+// GLFW's null platform with an OSMesa context. Rendering has to go to an FBO.
+struct HeadlessContext
+{
+	bool create();
+	void destroy();
+
+	const char* getBackendName() const { return backend; }
+
+private:
+	bool createEGL();
+	bool createOSMesa();
+
+	const char* backend = "none";
+
+	// kept as void* so EGL headers stay out of every includer
+	void* eglDisplay = nullptr;
+	void* eglContext = nullptr;
+
+	GLFWwindow* window = nullptr;
+};
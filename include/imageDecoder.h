@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Decoded image, rows top first. LDR images are RGBA8, HDR ones RGBA32F with the
+// floats stored in the same byte vector.
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	bool hdr = false;
+	std::vector<unsigned char> pixels;
+
+	int getBytesPerPixel() const { return hdr ? 16 : 4; }
+};
+
+// PNG, JPEG and Radiance HDR, told apart by their first bytes. PNG and JPEG need
+// libpng and libjpeg at build time, HDR is always there. Images wider or taller
+// than maxSize (GL_MAX_TEXTURE_SIZE, queried by the caller) are refused before
+// anything is allocated for them. Safe to call from any thread, touches no GL
+// state.
+bool decodeImage(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error);
+
+bool isImageFileName(const std::string& name);	// by extension
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// A read-only view of a whole file. Pages come in from disk as they are first
+// touched, so a large file costs no heap and nothing is read up front.
+struct MappedFile
+{
+	MappedFile() = default;
+	MappedFile(MappedFile&& other) noexcept { *this = static_cast<MappedFile&&>(other); }
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string& path);
+	void close();
+
+	// Asks the OS to start reading the range in the background.
+	void prefetch(size_t offset, size_t length) const;
+
+	const unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+	bool isOpen() const { return data != nullptr; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
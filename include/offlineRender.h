@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+struct OfflineRenderOptions
+{
+	std::string shaderPath;
+	int firstFrame = 0;
+	int lastFrame = 0;	// inclusive
+	int width = 1920;
+	int height = 1080;
+	double fps = 60.0;
+	std::string output = "frame_%05d.ppm";	// printf pattern, gets the frame number
+	std::string video;	// Y4M file or "|command", replaces the PPM frames when set
+	bool raw = false;	// bare I420 frames instead of Y4M
+	int tileSize = 0;	// render the image pass in tiles this big, 0 only tiles frames over the driver limit
+};
+
+// True when the command line asks for a headless render (--render).
+bool isOfflineRenderRequested(int argc, char** argv);
+
+// ShaderToy --render shader.frag [--frames 0-600] [--size 3840x2160] [--fps 60] [--tile 2048]
+//	[--output frame_%05d.ppm | --video out.y4m | --video "|ffmpeg -i - out.mp4"] [--raw]
+bool parseOfflineRenderArgs(int argc, char** argv, OfflineRenderOptions& options);
+
+// Renders every frame at a fixed timestep into an FBO and writes it out.
+// Returns the process exit code.
+int runOfflineRender(const OfflineRenderOptions& options);
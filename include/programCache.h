@@ -0,0 +1,39 @@
+#pragma once
+#include <glad/glad.h>
+#include <shaderLoader.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// Entries are keyed by the final stage sources plus the driver vendor, renderer
+// and version strings, so a driver update simply misses. A binary the driver
+// refuses anyway is deleted and rebuilt from source.
+// Every call needs a current GL context; the cache itself may be shared between threads.
+struct ProgramCache
+{
+	bool init(const std::string& directory, uint64_t maxBytes = 64ull * 1024 * 1024);
+	bool isEnabled() const { return enabled; }
+
+	uint64_t getKey(const std::vector<ShaderStageSource>& stages) const;
+
+	// Returns 0 on a miss.
+	GLuint load(uint64_t key);
+	void store(uint64_t key, GLuint program);
+
+private:
+	std::string getEntryPath(uint64_t key) const;
+	void evict();	// also measures totalBytes again
+
+	std::string directory;
+	std::string driver;
+	uint64_t driverHash = 0;
+	uint64_t maxBytes = 0;
+	uint64_t totalBytes = 0;	// kept up to date by store and load, so only eviction walks the directory
+	bool enabled = false;
+	std::mutex mutex;
+};
+
+// $XDG_CACHE_HOME/ShaderToy, ~/.cache/ShaderToy or %LOCALAPPDATA%/ShaderToy
+std::string getDefaultProgramCacheDirectory();
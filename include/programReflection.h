@@ -0,0 +1,121 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+struct UniformInfo
+{
+	std::string name;	// without a trailing "[0]"
+	GLenum type = 0;
+	GLint location = -1;	// -1 for block members
+	GLint arraySize = 1;
+	GLint blockIndex = -1;
+	GLint offset = -1;	// byte offset inside the block
+};
+
+struct UniformBlockInfo
+{
+	std::string name;
+	GLuint index = 0;
+	GLint binding = 0;
+	GLint dataSize = 0;
+};
+
+// Active uniforms of a linked program, queried once through the program
+// interface API (GL 4.3) instead of one glGetUniformLocation per name.
+struct ProgramReflection
+{
+	GLuint program = 0;
+	std::vector<UniformInfo> uniforms;
+	std::vector<UniformBlockInfo> blocks;
+
+	bool reflect(GLuint program);
+	const UniformInfo* find(const std::string& name) const;
+	const UniformBlockInfo* findBlock(const std::string& name) const;
+};
+
+enum BuiltinUniform
+{
+	UniformResolution,
+	UniformTime,
+	UniformTimeDelta,
+	UniformFrameRate,
+	UniformFrame,
+	UniformMouse,
+	UniformDate,
+	UniformTileOffset,
+	BuiltinUniformCount
+};
+
+const char* getBuiltinUniformName(BuiltinUniform u);
+
+// Built-ins a shader source names outside the ShaderToyInputs declaration, one
+// bit per BuiltinUniform. Every member of an std140 block counts as active, so
+// reflection can't tell which of them a program reads; the source can. Comments
+// are skipped, any other mention counts, so it errs on the side of "used".
+unsigned int findReferencedBuiltins(const std::string& source);
+
+// Whether the source names an identifier, skipped the same way.
+bool referencesIdentifier(const std::string& source, const char* name);
+
+struct BuiltinUniformValues
+{
+	float resolution[3] = {};
+	float time = 0;
+	float timeDelta = 0;
+	float frameRate = 0;
+	int frame = 0;
+	float mouse[4] = {};
+	float date[4] = {};
+	float channelResolution[4][3] = {};	// block only, 0 for unbound channels
+	float tileOffset[2] = {};	// where the drawn tile sits in the image
+	int sampleCount = 0;	// block only, samples accumulated so far
+};
+
+// Mirrors the std140 ShaderToyInputs block declared in front of the fragment shader.
+struct ShaderToyInputs
+{
+	float iResolution[3];
+	float iTime;
+	float iMouse[4];
+	float iDate[4];
+	float iTimeDelta;
+	float iFrameRate;
+	int iFrame;
+	float padding;
+	float iChannelResolution[4][4];	// vec3[4], std140 pads each element to a vec4
+	float iTileOffset[2];
+	int iSampleCount;
+	float padding2;	// std140 rounds the block up to a vec4
+};
+static_assert(sizeof(ShaderToyInputs) == 144, "ShaderToyInputs must match the std140 layout");
+
+const char* const ShaderToyInputsBlockName = "ShaderToyInputs";
+const GLuint ShaderToyInputsBinding = 0;
+
+void packShaderToyInputs(const BuiltinUniformValues& values, ShaderToyInputs& out);
+
+// The built-in inputs the current program actually reads. Rebuilt after every
+// link, uploads are then a walk over a few (location, type) pairs. Programs that
+// declare the ShaderToyInputs block get everything from the uniform buffer instead
+// and have no loose bindings; with their fragment source at hand, uses() still
+// knows which members they read.
+struct BuiltinUniformTable
+{
+	struct Binding
+	{
+		BuiltinUniform builtin;
+		GLint location;
+		GLenum type;
+	};
+
+	std::vector<Binding> bindings;
+	bool usesInputsBlock = false;
+	unsigned int blockReferences = ~0u;	// block members the source names, all without a source
+
+	void build(const ProgramReflection& reflection, const std::string& fragmentSource = std::string());
+	bool uses(BuiltinUniform u) const;
+
+	// Loose uniforms only, expects the program to be bound.
+	void upload(const BuiltinUniformValues& values) const;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+// One finished capture, the pixels point straight into the mapped buffer and
+// stay valid until the frame is released.
+struct ReadbackFrame
+{
+	const unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	size_t stride = 0;	// bytes per row, rows go bottom up like GL
+	long long tag = 0;	// whatever the caller passed to capture(), usually the frame number
+	int slot = -1;
+};
+
+// Reads frames back through a ring of pixel pack buffers so glReadPixels returns
+// immediately. Each slot gets a fence, is only mapped once that fence signaled and
+// then belongs to the consumer until release(), which may come from any thread.
+// Everything else runs on the GL thread.
+struct ReadbackRing
+{
+	bool init(int width, int height, int slotCount = 3);
+	void clear();
+
+	// Queues an RGBA8 read of the bound read framebuffer. Returns false when all
+	// slots are in flight or still held, so the caller should acquire first.
+	bool capture(long long tag, int x = 0, int y = 0);
+
+	// Oldest capture that is ready, in capture order. Without wait it never blocks.
+	bool acquire(ReadbackFrame& frame, bool wait = false);
+	void release(const ReadbackFrame& frame);
+
+	bool hasPending() const { return !inFlight.empty(); }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getSlotCount() const { return slotCount; }
+
+private:
+	enum SlotState { SlotFree, SlotInFlight, SlotMapped, SlotReleased };
+
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		long long tag = 0;
+		unsigned char* mapped = nullptr;
+		std::atomic<int> state = { SlotFree };
+	};
+
+	void recycleReleased();
+
+	int width = 0;
+	int height = 0;
+	size_t frameBytes = 0;
+	std::unique_ptr<Slot[]> slots;
+	int slotCount = 0;
+	std::vector<int> inFlight;	// oldest first
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <glad/glad.h>
+#include <shaderLoader.h>
+#include <programReflection.h>
+#include <uniformBufferRing.h>
+#include <fullscreenQuad.h>
+#include <gpuTimer.h>
+#include <string>
+#include <vector>
+
+enum RenderPassId
+{
+	PassBufferA,
+	PassBufferB,
+	PassBufferC,
+	PassBufferD,
+	PassImage,
+	RenderPassCount
+};
+
+const int ChannelCount = 4;
+
+const char* getRenderPassName(int pass);	// "Buffer A", "Image"
+const char* getRenderPassFileName(int pass);	// "bufferA.frag", the image pass is "fragment.frag"
+int findRenderPass(const std::string& name);	// by display name, -1 if unknown
+
+// Channel bindings are kept as "// iChannel0: Buffer A" lines in front of the
+// user code so they survive a save; any other name is an image, volume or cubemap
+// file, relative to the shader's folder. Unlisted channels are left unbound.
+void parseChannelBindings(const std::string& source, int channels[ChannelCount], std::string files[ChannelCount]);
+std::string formatChannelBindings(const int channels[ChannelCount], const std::string files[ChannelCount]);
+
+// A loaded file a channel samples: an image, a volume or a cubemap.
+struct ChannelTexture
+{
+	GLuint id = 0;
+	GLenum target = GL_TEXTURE_2D;
+	int size[3] = {};	// depth is 1 for 2D textures and cubemaps
+	unsigned int revision = 0;	// bumped when the contents change under the same id, as audio does
+
+	bool operator==(const ChannelTexture& o) const
+	{
+		return id == o.id && target == o.target && size[0] == o.size[0] && size[1] == o.size[1] && size[2] == o.size[2] &&
+			revision == o.revision;
+	}
+};
+
+struct RenderPass
+{
+	bool enabled = false;
+	Shader shader;
+	ProgramReflection reflection;
+	BuiltinUniformTable builtinUniforms;
+	int channels[ChannelCount] = { -1, -1, -1, -1 };	// buffer pass each iChannel reads, -1 for none
+
+	// file channels, the texture is 0 until it is loaded
+	std::string channelFiles[ChannelCount];
+	ChannelTexture channelTextures[ChannelCount];
+
+	// buffers only: drawn into the back target while the front one holds the last frame
+	GLuint textures[2] = {};
+	GLuint framebuffers[2] = {};
+	int front = 0;
+};
+
+// Where the image pass draws. It may be rendered smaller than the buffers, into
+// the corner of a larger framebuffer; iResolution and iMouse follow its size.
+// A framebuffer that only holds one tile of the image gets the tile's place in
+// the image: the tile is drawn at 0,0 and the prelude adds iTileOffset to
+// gl_FragCoord, so the shader sees the whole image.
+struct ImageTarget
+{
+	GLuint framebuffer = 0;
+	int width = 0;
+	int height = 0;
+
+	int tileX = 0;
+	int tileY = 0;
+	int tileWidth = 0;	// 0 draws the whole image
+	int tileHeight = 0;
+};
+
+// Buffer A-D and the Image pass. Buffers render into ping-ponged RGBA32F targets
+// and can read each other, or themselves, through iChannel0..3; a buffer that runs
+// earlier in the frame is seen as of this frame, anything else as of the last one.
+// The image pass always runs last, into the caller's framebuffer.
+struct RenderGraph
+{
+	RenderPass passes[RenderPassCount];
+
+	// Splits every draw into scissored tiles of this size with a flush after each,
+	// 0 draws each pass in one go.
+	int submitTileSize = 0;
+
+	bool init(FullscreenQuad* quad);
+	void clear();
+
+	// Takes ownership of the program, 0 just drops the old one. With the fragment
+	// source the pass also knows which ShaderToyInputs members it reads.
+	void setProgram(int pass, GLuint program, const std::string& fragmentSource = std::string());
+	void setEnabled(int pass, bool enabled);
+	void setChannel(int pass, int channel, int source);	// drops an image file
+	void setChannelFile(int pass, int channel, const std::string& file);
+	void setChannelTexture(int pass, int channel, const ChannelTexture& texture);
+	void setChannelBindings(int pass, const std::string& source);	// as parsed from the source
+
+	// Clears every buffer to zero, as on the first frame.
+	void resetBuffers();
+
+	// Whether any pass that will run reads the built-in.
+	bool uses(BuiltinUniform u) const;
+	bool passUses(int pass, BuiltinUniform u) const;
+
+	// Buffers are width x height. Resolution and channel resolutions are filled
+	// in per pass, the mouse is expected in width x height pixels.
+	void render(const BuiltinUniformValues& inputs, int width, int height, const ImageTarget& image, GpuTimer* timer = nullptr);
+
+	// The two halves of render(), for drawing the image in several tiles per frame.
+	void renderBuffers(const BuiltinUniformValues& inputs, int width, int height, GpuTimer* timer = nullptr);
+	void renderImage(const BuiltinUniformValues& inputs, const ImageTarget& image, GpuTimer* timer = nullptr);
+
+	const std::vector<int>& getOrder();
+
+	// Whether a buffer reads the last frame of itself or of a later buffer, the
+	// passes then draw something new every frame whatever the inputs.
+	bool hasFeedback();
+
+	// Bumped whenever something other than the inputs changes what the passes
+	// draw: programs, channels, channel textures, enabled buffers, buffer resets.
+	unsigned int getVersion() const { return version; }
+
+private:
+	void updateOrder();
+	void drawPass(int pass, BuiltinUniformValues& values, int drawWidth, int drawHeight, GpuTimer* timer);
+	void createTargets(RenderPass& p);
+	void deleteTargets(RenderPass& p);
+
+	FullscreenQuad* quad = nullptr;
+	UniformBufferRing inputsRing;
+	std::vector<int> order;	// enabled buffers in the order they run
+	bool orderDirty = true;
+	bool feedback = false;
+	unsigned int version = 0;
+	int width = 0;
+	int height = 0;
+};
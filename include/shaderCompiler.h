@@ -0,0 +1,86 @@
+#pragma once
+#include <glad/glad.h>
+#include <shaderLoader.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct GLFWwindow;
+
+struct CompileResult
+{
+	unsigned int ticket = 0;
+	int slot = 0;
+	bool success = false;
+	GLuint program = 0;
+	ShaderDiagnostics diagnostics;
+	std::string fragmentSource;	// as submitted, for RenderGraph::setProgram
+};
+
+// Builds shader programs off the render thread. When the driver exposes
+// GL_KHR_parallel_shader_compile the program is compiled on the render thread's
+// own context and polled for completion, otherwise the work is moved to a worker
+// thread that owns a hidden context shared with the main window.
+// The caller keeps rendering with its current program until poll() hands back a
+// linked one.
+struct ShaderCompileService
+{
+	// The cache, when given, is consulted before compiling and filled after linking.
+	bool init(GLFWwindow* mainWindow, ProgramCache* cache = nullptr);
+	void shutdown();
+
+	// Queues a build and returns its ticket. A newer submit to the same slot
+	// supersedes a build that has not started yet, slots (one per render pass)
+	// build independently.
+	unsigned int submit(const std::vector<ShaderStageSource>& stages, int slot = 0);
+
+	// Non-blocking, call once per frame from the render thread.
+	// Returns true when a build finished; on success the caller owns result.program.
+	bool poll(CompileResult& result);
+
+	bool isBusy() const;
+	bool usesParallelCompile() const { return parallelCompile; }
+
+private:
+	struct Job
+	{
+		unsigned int ticket = 0;
+		int slot = 0;
+		std::vector<ShaderStageSource> stages;
+	};
+
+	struct PendingProgram
+	{
+		unsigned int ticket = 0;
+		int slot = 0;
+		ProgramBuild build;
+		GLuint program = 0;
+		GLsync fence = 0;
+		bool finished = false;
+		ShaderDiagnostics diagnostics;
+		std::string fragmentSource;
+	};
+
+	void workerLoop();
+	void build(const Job& job, PendingProgram& out);
+	bool isComplete(const PendingProgram& p) const;
+	void finish(PendingProgram& p, CompileResult& result);
+	void discard(PendingProgram& p);
+	void discardSlot(std::vector<PendingProgram>& programs, int slot);
+
+	GLFWwindow* workerWindow = nullptr;
+	ProgramCache* cache = nullptr;
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+
+	bool building = false;
+	bool running = false;
+	bool parallelCompile = false;
+	unsigned int nextTicket = 0;
+
+	std::vector<Job> jobs;	// at most one per slot
+	std::vector<PendingProgram> pending;	// at most one per slot
+};
@@ -1,10 +1,87 @@
 #pragma once
 #include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+struct ProgramCache;
+
+struct ShaderStageSource
+{
+	GLenum type = GL_FRAGMENT_SHADER;
+	std::string source;
+	std::string name;	// used for error reporting
+
+	// number of source lines in front of the code the user sees, error lines are
+	// shifted by this much so they land on the right line of the editor
+	int lineOffset = 0;
+
+	ShaderStageSource() = default;
+	ShaderStageSource(GLenum type, std::string source, std::string name = std::string(), int lineOffset = 0)
+		: type(type), source(std::move(source)), name(std::move(name)), lineOffset(lineOffset) {}
+};
+
+struct ShaderStageDiagnostics
+{
+	GLenum type = 0;
+	std::string name;
+	bool compiled = false;
+	std::string log;
+	std::map<int, std::string> lineMap; // user line (1 based) -> message
+	double compileMs = 0;
+};
+
+struct ShaderDiagnostics
+{
+	std::vector<ShaderStageDiagnostics> stages;
+	bool linked = false;
+	std::string linkLog;
+	double compileMs = 0;
+	double linkMs = 0;	// compile and link together when the stages weren't timed
+	bool stagesTimed = false;
+	bool fromCache = false;
+
+	bool success() const { return linked; }
+	const ShaderStageDiagnostics* getStage(GLenum type) const;
+
+	// everything that went wrong, one block per failing stage
+	std::string getErrors() const;
+};
+
+// A program whose stages were handed to the driver but not checked yet, used to
+// keep the render thread from blocking when the driver compiles in the background.
+struct ProgramBuild
+{
+	GLuint program = 0;
+	std::vector<GLuint> shaderIds;
+	std::vector<ShaderStageSource> stages;
+	std::chrono::steady_clock::time_point start;
+	ProgramCache* cache = nullptr;
+	uint64_t cacheKey = 0;
+	bool fromCache = false;
+};
+
+// Compiles every stage once and links once, returns 0 on failure.
+// With a cache the program is restored from a stored binary when possible.
+GLuint buildProgram(const std::vector<ShaderStageSource>& stages, ShaderDiagnostics& diagnostics,
+	ProgramCache* cache = nullptr);
+
+ProgramBuild beginProgramBuild(const std::vector<ShaderStageSource>& stages, ProgramCache* cache = nullptr);
+GLuint finishProgramBuild(ProgramBuild& build, ShaderDiagnostics& diagnostics);
+void cancelProgramBuild(ProgramBuild& build);
 
 struct Shader
 {
 	GLuint id = 0;
 
+	// Replaces the current program only if the new one links.
+	// Errors are printed when no diagnostics are asked for.
+	bool build(const std::vector<ShaderStageSource>& stages, ShaderDiagnostics* diagnostics = nullptr,
+		ProgramCache* cache = nullptr);
+
 	bool loadShaderProgramFromData(const char* vertexShaderData, const char* fragmentShaderData);
 	bool loadShaderProgramFromData(const char* vertexShaderData,
 		const char* geometryShaderData, const char* fragmentShaderData);
@@ -20,4 +97,9 @@ struct Shader
 	GLint getUniform(const char* name);
 };
 
-GLint getUniform(GLuint shaderId, const char* name);
\ No newline at end of file
+GLint getUniform(GLuint shaderId, const char* name);
+
+bool readShaderFile(const char* name, std::string& out);
+
+// Pulls line numbers out of a GLSL info log, lines in front of lineOffset are dropped.
+std::map<int, std::string> parseShaderLog(const std::string& log, int lineOffset = 0);
@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <cstddef>
+
+// Where a texture's level 0 sits in memory and how it goes to GL. Layers are
+// the slices of a volume or the faces of a cubemap, plain images have one.
+struct TextureLayout
+{
+	GLenum target = GL_TEXTURE_2D;
+	int width = 0;
+	int height = 0;
+	int depth = 1;
+	int layers = 1;
+
+	GLenum internalFormat = GL_RGBA8;
+	GLenum format = GL_RGBA;
+	GLenum type = GL_UNSIGNED_BYTE;
+	int unpackAlignment = 4;
+
+	const unsigned char* data = nullptr;
+	size_t rowBytes = 0;	// including any alignment padding
+	size_t layerStride = 0;
+	bool flipRows = false;	// rows are stored top first
+
+	size_t getTotalBytes() const { return rowBytes * height * layers; }
+};
+
+// Volumes and cubemaps, read in place: KTX 1 files with uncompressed data
+// (2D, 3D or cubemap, level 0 only, the GPU builds the mips) and the .bin
+// volumes shadertoy.com uses. The layout points into data, which has to
+// outlive it.
+bool parseTextureFile(const unsigned char* data, size_t size, TextureLayout& layout, std::string& error);
+bool isTextureFileName(const std::string& name);	// .ktx, .bin
+
+// Anything a channel can load, images and audio included.
+bool isChannelFileName(const std::string& name);
+
+// GL_TEXTURE_2D, GL_TEXTURE_3D or GL_TEXTURE_CUBE_MAP, from the file's header;
+// 2D when it can't be read.
+GLenum getChannelFileTarget(const std::string& path);
+const char* getSamplerTypeName(GLenum target);	// "sampler2D"
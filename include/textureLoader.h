@@ -0,0 +1,120 @@
+#pragma once
+#include <glad/glad.h>
+#include <imageDecoder.h>
+#include <textureFile.h>
+#include <mappedFile.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Loads image files into mipmapped textures without stalling the render thread.
+// Files are read, hashed and decoded on a small pool of worker threads; the
+// render thread then streams the pixels through a pixel unpack buffer a few
+// megabytes per frame and has the GPU build the mip chain. Files with the same
+// contents share one texture, a second copy is never decoded.
+// Volumes and cubemaps (see textureFile.h) are memory mapped instead of read:
+// slices and faces are copied from the mapping straight into the unpack buffer,
+// the file is never held in the heap. They are told apart by path, hashing
+// hundreds of megabytes just to find duplicates would defeat the point.
+struct TextureLoader
+{
+	// Bytes copied into textures per update(), at least one row always goes.
+	size_t uploadBudget = 4 << 20;
+
+	bool init(int threads = 0);	// 0 picks from the core count
+	void clear();
+
+	// Returns a handle right away, the same path gets the same handle back.
+	// Every request needs a release().
+	int request(const std::string& path);
+	void release(int handle);
+
+	// Call once per frame on the render thread, uploads within the budget.
+	void update();
+
+	// False until the texture is fully uploaded, or when loading it failed.
+	// size is width, height and depth, depth 1 for 2D textures and cubemaps.
+	bool getTexture(int handle, GLuint& texture, GLenum& target, int size[3]) const;
+	bool hasFailed(int handle) const;
+
+	// Bytes on the GPU so far and in total, false before the file is opened.
+	bool getResidency(int handle, size_t& uploaded, size_t& total) const;
+	bool isBusy() const;
+
+	// Blocks until every request is done, for offline rendering.
+	void finish();
+
+private:
+	struct Request
+	{
+		std::string path;
+		int refs = 0;
+		unsigned int generation = 0;	// tells a reused handle from its last owner
+		uint64_t hash = 0;	// 0 while loading
+		bool failed = false;
+	};
+
+	struct Texture
+	{
+		GLuint id = 0;
+		TextureLayout layout;
+		int refs = 0;
+		bool ready = false;
+
+		// where layout.data points, kept until uploaded
+		DecodedImage image;
+		MappedFile file;
+		size_t uploadedRows = 0;	// over all layers
+	};
+
+	struct Job
+	{
+		int handle = 0;
+		unsigned int generation = 0;
+		std::string path;
+	};
+
+	struct Result
+	{
+		int handle = 0;
+		unsigned int generation = 0;
+		uint64_t hash = 0;
+		bool duplicate = false;	// same contents as one already decoded, image is empty
+		DecodedImage image;
+		MappedFile file;
+		TextureLayout layout;	// into file, or filled in for the image later
+		std::string error;
+	};
+
+	void workerLoop();
+	void load(const Job& j, Result& r);
+	void collect(Result& r);
+	bool uploadRows(Texture& t, size_t& budget);
+	void deleteUnused();
+
+	std::vector<std::thread> workers;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool running = false;
+
+	std::deque<Job> jobs;
+	std::vector<Result> results;
+	std::unordered_set<uint64_t> claimedHashes;	// decoded, or being decoded, by some worker
+
+	// render thread only
+	std::vector<Request> requests;	// indexed by handle, refs 0 is free
+	std::unordered_map<uint64_t, Texture> textures;
+	std::unordered_set<uint64_t> failedHashes;
+	std::deque<uint64_t> uploads;
+	int loading = 0;	// jobs not yet back from the workers
+	GLuint unpackBuffer = 0;
+	GLint maxTextureSize = 0;
+	GLint max3DTextureSize = 0;
+	GLint maxCubeMapSize = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <cstdint>
+
+// A uniform buffer split into a few slots that is mapped once and written by the
+// CPU while the GPU may still read the previous frames' slots. Each slot is fenced
+// after the draws that use it and only rewritten once that fence has passed.
+// Falls back to glBufferSubData into a single slot without glBufferStorage.
+struct UniformBufferRing
+{
+	bool init(GLsizeiptr blockSize, int slotCount = 3);
+	void clear();
+
+	// Copies the block into the next free slot and binds it. Does nothing and
+	// returns false when the data didn't change since the last write.
+	bool write(const void* data, GLuint bindingPoint);
+
+	// Call after the draws that read the current slot. Only a slot written since
+	// the last call gets a new fence; one that is merely read again is fenced
+	// once, when write() moves on from it.
+	void fence();
+
+	GLuint id = 0;
+
+private:
+	GLsizeiptr blockSize = 0;
+	GLsizeiptr stride = 0;
+	int slotCount = 0;
+	int current = -1;
+	unsigned char* mapped = nullptr;
+	std::vector<GLsync> fences;
+	std::vector<unsigned char> last;
+	bool hasLast = false;
+	bool written = false;	// the current slot has no fence after its latest write
+	bool reused = false;	// it was drawn from again after its fence
+	bool bound = false;
+	GLuint boundPoint = 0;
+};
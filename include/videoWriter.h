@@ -0,0 +1,100 @@
+#pragma once
+#include <readbackRing.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+
+// Converts RGBA8 rows as read from GL (bottom up) into I420 planes, top down and
+// full range BT.601. C420jpeg only gives the chroma siting, so the Y4M header
+// also says XCOLORRANGE=FULL or readers would take it for limited range. Only
+// rows [firstRow, endRow) of the output are written, firstRow must be even.
+// Uses SSE2 where available.
+void convertRGBAToI420(const unsigned char* rgba, size_t stride, int width, int height,
+	unsigned char* y, unsigned char* u, unsigned char* v, int firstRow, int endRow);
+
+struct VideoWriterOptions
+{
+	std::string output;	// file path, or "|command" to pipe into an encoder
+	bool raw = false;	// bare I420 planes instead of Y4M
+	int width = 0;
+	int height = 0;
+	int fpsNumerator = 60;
+	int fpsDenominator = 1;
+	int threads = 0;	// converter threads, 0 picks from the core count
+	int queueFrames = 4;	// converted frames that may wait for the disk
+};
+
+// Streams readback frames to a Y4M or raw I420 file or pipe. Frames are converted
+// straight out of the mapped pixel buffers by a pool of threads, in horizontal
+// stripes, and handed back to the readback ring as soon as they are converted;
+// a separate thread writes them out in order. submit() never blocks: when every
+// queue slot is taken it refuses the frame and the caller decides whether to drop
+// it (interactive recording) or to wait (offline render).
+struct VideoWriter
+{
+	bool open(const VideoWriterOptions& options);
+	void close();	// writes out everything still queued
+	bool isOpen() const { return opened; }
+
+	// On success the writer owns the frame and releases it to the ring itself.
+	bool submit(const ReadbackFrame& frame, ReadbackRing& ring);
+	void waitForSpace();
+
+	// Blocks until fewer than heldLimit readback frames are still being converted,
+	// for a capture that found every slot of the ring held by the writer.
+	void waitForRelease(int heldLimit);
+
+	long long getWrittenFrames();
+	bool hasFailed();
+
+private:
+	enum FrameState { FrameFree, FrameConverting, FrameConverted };
+
+	struct QueuedFrame
+	{
+		std::vector<unsigned char> yuv;
+		ReadbackFrame source;
+		ReadbackRing* ring = nullptr;
+		long long sequence = 0;
+		int stripesLeft = 0;
+		FrameState state = FrameFree;
+	};
+
+	struct Stripe
+	{
+		int frame;
+		int firstRow;
+		int endRow;
+	};
+
+	void converterLoop();
+	void writerLoop();
+
+	VideoWriterOptions options;
+	bool opened = false;
+	bool stopping = false;
+	bool failed = false;
+
+	FILE* file = nullptr;
+	bool pipe = false;
+	size_t frameBytes = 0;
+
+	std::vector<QueuedFrame> frames;
+	std::deque<Stripe> stripes;	// pending conversion work, oldest frame first
+	long long nextSequence = 0;
+	long long nextWrite = 0;
+	long long written = 0;
+	int heldSources = 0;	// frames still reading from a readback slot
+
+	std::mutex mutex;
+	std::condition_variable stripeReady;
+	std::condition_variable frameConverted;
+	std::condition_variable frameFreed;
+	std::condition_variable sourceReleased;
+	std::vector<std::thread> converters;
+	std::thread writer;
+};
@@ -1,12 +1,30 @@
-#version 460 core
+#version 450 core
 
 layout(location = 0) out vec4 fragColor;
 in vec2 fragCoord;
 
-uniform float iTime;
-uniform vec4 iDate;
+// Built-in inputs, filled once per pass from a uniform buffer
+layout(std140, binding = 0) uniform ShaderToyInputs
+{
+    vec3 iResolution;
+    float iTime;
+    vec4 iMouse;
+    vec4 iDate;
+    float iTimeDelta;
+    float iFrameRate;
+    int iFrame;
+    vec3 iChannelResolution[4];
+    vec2 iTileOffset;   // where this tile sits when the image is rendered in tiles
+    int iSampleCount;   // samples averaged so far in accumulation mode, 0 otherwise
+};
+
+// Buffer outputs and files, as bound below
+uniform sampler2D iChannel0;
+uniform sampler2D iChannel1;
+uniform sampler2D iChannel2;
+uniform sampler2D iChannel3;
+
 uniform vec3 u_color;
-uniform vec2 iResolution;
 
 // BEGIN_USER_CODE
 vec3 userColor(vec2 uv)
@@ -18,7 +36,7 @@ vec3 userColor(vec2 uv)
 
 void main()
 {
-    vec2 uv = gl_FragCoord.xy / iResolution.xy;
+    vec2 uv = (gl_FragCoord.xy + iTileOffset) / iResolution.xy;
     vec3 col = userColor(uv);
     fragColor = vec4(col, 1.0);
 }
@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 
 layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_color;
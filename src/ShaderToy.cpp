@@ -10,6 +10,25 @@
 
 #include <openglDebug.h>
 #include <shaderLoader.h>
+#include <shaderCompiler.h>
+#include <programCache.h>
+#include <fileWatcher.h>
+#include <programReflection.h>
+#include <uniformBufferRing.h>
+#include <fullscreenQuad.h>
+#include <offlineRender.h>
+#include <readbackRing.h>
+#include <frameOutput.h>
+#include <videoWriter.h>
+#include <gpuTimer.h>
+#include <frameProfiler.h>
+#include <renderGraph.h>
+#include <dynamicResolution.h>
+#include <accumulator.h>
+#include <frameCache.h>
+#include <textureLoader.h>
+#include <channelTextures.h>
+#include <textureFile.h>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -17,23 +36,12 @@
 
 using namespace std;
 
-float triangleVertices[] = {
-		1.0, 1.0, 0,	1, 0, 0,	// Vertex 1
-	   -1.0, 1.0, 0,	0, 1, 0,	// Vertex 2
-	   -1.0, -1.0, 0,	0, 0, 1,	// Vertex 3
-		1.0, -1.0, 0,	0, 0, 1		// Vertex 4
-};
-
-unsigned short indices[] = {
-	0, 1, 2,
-	0, 2, 3
-};
-
 double lastMouseX = 0.0;
 double lastMouseY = 0.0;
 bool firstMouse = true;
 
-static TextEditor editor;
+static TextEditor editors[RenderPassCount];
+static int currentPass = PassImage;
 static bool shaderDirty = false;
 static std::string userShaderCode;
 
@@ -69,19 +77,6 @@ static void mouse_button_callback(GLFWwindow* window, int button, int action, in
 }
 
 
-std::filesystem::file_time_type getFileLastWriteTime(const std::string& filePath)
-{
-	try
-	{
-		return std::filesystem::last_write_time(filePath);
-	}
-	catch (const std::filesystem::filesystem_error& e)
-	{
-		std::cerr << "Error getting last write time for file " << filePath << ": " << e.what() << std::endl;
-		return std::filesystem::file_time_type::min();
-	}
-}
-
 std::string loadUserShaderSection(const std::string& path) {
 	std::ifstream file(path);
 	std::string line;
@@ -105,161 +100,94 @@ std::string loadUserShaderSection(const std::string& path) {
 	return content;
 }
 
-std::string buildFullFragmentShader(const std::string& userCode) {
+std::string buildFullFragmentShader(const std::string& userCode, const int channels[ChannelCount], const std::string files[ChannelCount]) {
+	// code pasted from shadertoy.com defines mainImage, ours defines userColor
+	bool hasMainImage = userCode.find("mainImage") != std::string::npos;
+
+	// volumes and cubemaps need their own sampler types
+	std::string samplers;
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		GLenum target = files[c].empty() ? GL_TEXTURE_2D : getChannelFileTarget((std::filesystem::path(RESOURCES_PATH) / files[c]).string());
+		samplers += std::string("uniform ") + getSamplerTypeName(target) + " iChannel" + std::to_string(c) + ";\n";
+	}
+
 	return
-		R"(#version 460 core
+		R"(#version 450 core
 
 layout(location = 0) out vec4 fragColor;
 in vec2 fragCoord;
 
-uniform float iTime;
-uniform vec4 iDate;
+// Built-in inputs, filled once per pass from a uniform buffer
+layout(std140, binding = 0) uniform ShaderToyInputs
+{
+    vec3 iResolution;
+    float iTime;
+    vec4 iMouse;
+    vec4 iDate;
+    float iTimeDelta;
+    float iFrameRate;
+    int iFrame;
+    vec3 iChannelResolution[4];
+    vec2 iTileOffset;   // where this tile sits when the image is rendered in tiles
+    int iSampleCount;   // samples averaged so far in accumulation mode, 0 otherwise
+};
+
+// Buffer outputs and files, as bound below
+)" + samplers + R"(
 uniform vec3 u_color;
-uniform vec2 iResolution;
 
-// BEGIN_USER_CODE
+)" + formatChannelBindings(channels, files) +
+R"(// BEGIN_USER_CODE
 )" + userCode +
 R"(// END_USER_CODE
 
 void main()
 {
-    vec2 uv = gl_FragCoord.xy / iResolution.xy;
+)" + (hasMainImage ?
+R"(    mainImage(fragColor, gl_FragCoord.xy + iTileOffset);
+)" :
+R"(    vec2 uv = (gl_FragCoord.xy + iTileOffset) / iResolution.xy;
     vec3 col = userColor(uv);
     fragColor = vec4(col, 1.0);
-}
-)";
+)") + "}\n";
 }
 
-GLuint loadShaderFromString(GLenum type, const std::string& source)
+static const char* const defaultBufferCode =
+R"(void mainImage(out vec4 fragColor, in vec2 fragCoord)
 {
-	GLuint shader = glCreateShader(type);
-	const char* src = source.c_str();
-	glShaderSource(shader, 1, &src, nullptr);
-	glCompileShader(shader);
-
-	// Check compiler errors
-	GLint success;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-	if (!success) {
-		GLint logLength;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-
-		std::string log(logLength, ' ');
-		glGetShaderInfoLog(shader, logLength, nullptr, &log[0]);
-
-		std::cerr << "[Shader Error] Compile failed:\n" << log << std::endl;
-
-		glDeleteShader(shader);
-		return 0;
-	}
-
-	return shader;
+    vec2 uv = fragCoord / iResolution.xy;
+    fragColor = vec4(uv, 0.5 + 0.5 * sin(iTime), 1.0);
 }
+)";
 
-GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader)
+// Lines in front of the user section, used to map compiler errors back onto the editor
+int getUserCodeLineOffset(const std::string& source)
 {
-	GLuint program = glCreateProgram();
-	if (!program) {
-		std::cerr << "Error: Failed to create GL program\n";
+	size_t marker = source.find("// BEGIN_USER_CODE");
+	if (marker == std::string::npos)
 		return 0;
-	}
-
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-
-	glLinkProgram(program);
-
-	// Check linking errors
-	GLint success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
 
-	if (!success) {
-		GLint logLength = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-		std::string log(logLength, ' ');
-		glGetProgramInfoLog(program, logLength, nullptr, log.data());
-
-		std::cerr << "[Program Link Error]\n" << log << std::endl;
-
-		glDeleteProgram(program);
-		return 0;
-	}
-
-	// Optional: detach shaders after linking
-	glDetachShader(program, vertexShader);
-	glDetachShader(program, fragmentShader);
-
-	return program;
+	return (int)std::count(source.begin(), source.begin() + marker, '\n') + 1;
 }
 
-bool compileShaderWithErrors(GLenum type, const std::string& src, GLuint& outShader, std::string& outErrors)
+std::vector<ShaderStageSource> buildShaderStages(const std::string& vertexSource, const std::string& fragmentSource,
+	const std::string& fragmentName)
 {
-	outErrors.clear();
-	outShader = glCreateShader(type);
-
-	const char* csrc = src.c_str();
-	glShaderSource(outShader, 1, &csrc, nullptr);
-	glCompileShader(outShader);
-
-	GLint success = 0;
-	glGetShaderiv(outShader, GL_COMPILE_STATUS, &success);
-
-	if (!success) {
-		GLint logSize = 0;
-		glGetShaderiv(outShader, GL_INFO_LOG_LENGTH, &logSize);
-		outErrors.resize(logSize);
-		glGetShaderInfoLog(outShader, logSize, nullptr, &outErrors[0]);
-
-		glDeleteShader(outShader);
-		outShader = 0;
-		return false;
-	}
-
-	return true;
+	return {
+		{ GL_VERTEX_SHADER, vertexSource, RESOURCES_PATH "vertex.vert" },
+		{ GL_FRAGMENT_SHADER, fragmentSource, fragmentName, getUserCodeLineOffset(fragmentSource) } };
 }
 
-TextEditor::ErrorMarkers buildErrorMarkers(const std::string& log)
+int main(int argc, char** argv)
 {
-	TextEditor::ErrorMarkers markers;
-
-	std::istringstream iss(log);
-	std::string line;
-
-	while (std::getline(iss, line)) {
-		// typical GLSL formats:
-		// 0(17) : error C1008: ...
-		// ERROR: 0:17: 'xxx' : error
-		int lineNum = -1;
-
-		// Pattern 1: 0(17)
-		size_t open = line.find('(');
-		size_t close = line.find(')');
-		if (open != std::string::npos && close != std::string::npos && close > open) {
-			lineNum = std::stoi(line.substr(open + 1, close - open - 1));
-		}
-
-		// Pattern 2: ERROR: 0:17:
-		size_t colon1 = line.find(':');
-		size_t colon2 = line.find(':', colon1 + 1);
-		if (colon1 != std::string::npos && colon2 != std::string::npos) {
-			try {
-				lineNum = std::stoi(line.substr(colon1 + 1, colon2 - colon1 - 1));
-			}
-			catch (...) {}
-		}
-
-		if (lineNum >= 0) {
-			markers[lineNum] = line;
-		}
+	if (isOfflineRenderRequested(argc, argv))
+	{
+		OfflineRenderOptions options;
+		if (!parseOfflineRenderArgs(argc, argv, options)) { return 1; }
+		return runOfflineRender(options);
 	}
 
-	return markers;
-}
-
-int main()
-{
 	if (!glfwInit())
 	{
 		std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -298,47 +226,67 @@ int main()
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init("#version 460");
 
-	// Vertex Array Object
-	GLuint vao = 0;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	FullscreenQuad quad;
+	quad.create();
+
+	ProgramCache programCache;
+	programCache.init(getDefaultProgramCacheDirectory());
 
-	// Vertex Buffer Object
-	GLuint vbo = 0;
-	glGenBuffers(1, &vbo);
+	std::string vertexShaderSource;
+	readShaderFile(RESOURCES_PATH "vertex.vert", vertexShaderSource);
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);
+	// Buffer A-D and the image pass, each compiled into its own compiler slot
+	RenderGraph graph;
+	graph.init(&quad);
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+	// Optionally renders the image pass smaller to hold a GPU time budget
+	DynamicResolution dynamicResolution;
+	dynamicResolution.init();
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	// Image files for the channels, decoded off the render thread and uploaded a
+	// few megabytes per frame
+	TextureLoader textureLoader;
+	textureLoader.init();
+	ChannelTextures channelTextures;
+	std::vector<std::string> channelFileChoices;	// offered in the channel menus
 
-	// Index Buffer Object
-	GLuint ibo = 0;
-	glGenBuffers(1, &ibo);
+	// Averages frames for path tracers, drawing stops once enough samples are in
+	Accumulator accumulator;
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	// The last frame, shown again while nothing the shaders read has changed
+	FrameCache frameCache;
+	bool frameReused = false;
 
+	ShaderCompileService compiler;
+	compiler.init(window, &programCache);
+	unsigned int fileReloadTickets[RenderPassCount] = {};
 
-	// Unbind VAO
-	glBindVertexArray(0);
+	// Pass files live next to fragment.frag; a buffer is on when its file exists.
+	// The last source read from or written to disk is kept per pass, so our own Save
+	// and writes that don't change anything don't trigger a reload
+	std::string passPaths[RenderPassCount];
+	std::string savedPassSources[RenderPassCount];
 
-	Shader s;
-	s.loadShaderProgramFromFile(RESOURCES_PATH "vertex.vert", RESOURCES_PATH "fragment.frag");
-	s.bind();
+	for (int i = 0; i < RenderPassCount; i++)
+	{
+		passPaths[i] = std::string(RESOURCES_PATH) + getRenderPassFileName(i);
+		editors[i].SetLanguageDefinition(TextEditor::LanguageDefinition::GLSL());
+
+		if (i != PassImage && !std::filesystem::exists(passPaths[i])) { continue; }
+		if (!readShaderFile(passPaths[i].c_str(), savedPassSources[i])) { continue; }
 
-	GLint u_resolution = s.getUniform("iResolution");
-	GLint u_time = s.getUniform("iTime");
-	GLint u_time_delta = s.getUniform("iTimeDelta");
-	GLint u_frame_rate = s.getUniform("iFrameRate");
-	GLint u_frame = s.getUniform("iFrame");
-	GLint u_mouse = s.getUniform("iMouse");
-	GLint u_date = s.getUniform("iDate");
+		graph.setEnabled(i, true);
+		graph.setChannelBindings(i, savedPassSources[i]);
+		editors[i].SetText(loadUserShaderSection(passPaths[i]));
+
+		Shader s;
+		s.build(buildShaderStages(vertexShaderSource, savedPassSources[i], passPaths[i]), nullptr, &programCache);
+		graph.setProgram(i, s.id, savedPassSources[i]);
+	}
 
+	// iDate only changes once a second, no need to call localtime every frame
+	time_t dateSecond = 0;
+	float date[4] = {};
 
 	static int frameCount = 0;
 
@@ -346,10 +294,13 @@ int main()
 	bool timerActive = false;  // Start paused
 	float lastFrameTime = (float)glfwGetTime();
 
-	std::string fragmentShaderPath = RESOURCES_PATH "fragment.frag";
-	auto lastWriteTime = getFileLastWriteTime(fragmentShaderPath);
+	// Shader files are watched off the render thread, changes arrive debounced
+	FileWatcher watcher;
+	watcher.start();
+	watcher.addFile(RESOURCES_PATH "vertex.vert");
+	for (auto& path : passPaths) { watcher.addFile(path); }
 
-	userShaderCode = loadUserShaderSection(fragmentShaderPath);
+	userShaderCode = loadUserShaderSection(passPaths[PassImage]);
 
 	if (userShaderCode.empty()) {
 		userShaderCode =
@@ -360,36 +311,147 @@ int main()
 				)";
 	}
 
-	editor.SetLanguageDefinition(TextEditor::LanguageDefinition::GLSL());
-	editor.SetText(userShaderCode);
+	editors[PassImage].SetText(userShaderCode);
+	int selectPass = -1;	// tab to bring to the front on the next frame
 
 	static bool compileShaderFromEditor = false;
 
+	// Screenshots are read back asynchronously and written once the GPU is done
+	ReadbackRing screenshots;
+	bool screenshotRequested = false;
+	int screenshotCount = 0;
+
+	// Recording streams the same way into a Y4M file, frames the writer can't
+	// take right away are dropped instead of stalling the window
+	ReadbackRing recordingFrames;
+	VideoWriter recorder;
+	int recordingCount = 0;
+	long long droppedFrames = 0;
+
+	auto stopRecording = [&]()
+	{
+		ReadbackFrame f;
+		while (recordingFrames.acquire(f, true))
+		{
+			while (!recorder.submit(f, recordingFrames)) { recorder.waitForSpace(); }
+		}
+		recorder.close();
+		recordingFrames.clear();
+		std::cout << "Recording stopped, " << recorder.getWrittenFrames() << " frames written, " << droppedFrames << " dropped.\n";
+	};
+
+	// GPU time per pass, read back a few frames late so it never stalls
+	GpuTimer gpuTimer;
+	gpuTimer.init();
+
+	// CPU time per stage of the loop, shown in the profiler window
+	FrameProfiler profiler;
+	const int stageFilePolling = profiler.addStage("File polling");
+	const int stageImGuiBuild = profiler.addStage("ImGui build");
+	const int stageEditorRender = profiler.addStage("Editor render");
+	const int stageTextureUpload = profiler.addStage("Texture upload");
+	const int stageUniformUpdate = profiler.addStage("Uniform update");
+	const int stageDraw = profiler.addStage("Draw");
+	const int stageImGuiRender = profiler.addStage("ImGui render");
+	const int stageSwap = profiler.addStage("Swap");
+	const int stageEventPoll = profiler.addStage("Event poll");
+	bool showProfiler = false;
+
 	while (!glfwWindowShouldClose(window))
 	{
 		frameCount++;
+		profiler.beginFrame();
+		gpuTimer.beginFrame();
 		float currentFrameTime = (float)glfwGetTime();
 		float deltaTime = currentFrameTime - lastFrameTime;
 		lastFrameTime = currentFrameTime;
 
-		auto currentWriteTime = getFileLastWriteTime(fragmentShaderPath);
+		profiler.begin(stageFilePolling);
 
-		if (currentWriteTime != lastWriteTime)
+		bool shaderFilesChanged = false;
+		int changedFile = 0;
+		while (watcher.poll(changedFile)) { shaderFilesChanged = true; }
+
+		if (shaderFilesChanged)
 		{
-			std::cout << "Detected change in fragment shader. Reloading..." << std::endl;
-			if (s.loadShaderProgramFromFile(RESOURCES_PATH "vertex.vert", RESOURCES_PATH "fragment.frag"))
+			std::string vertexSource;
+			bool vertexChanged = readShaderFile(RESOURCES_PATH "vertex.vert", vertexSource) && vertexSource != vertexShaderSource;
+			if (vertexChanged) { vertexShaderSource = vertexSource; }
+
+			for (int i = 0; i < RenderPassCount; i++)
 			{
-				timer = 0.0f;
-				timerActive = false; // restart paused
-				std::cout << "Shader reloaded successfully." << std::endl;
+				std::string fragmentSource;
+				if (i != PassImage && !std::filesystem::exists(passPaths[i])) { continue; }
+				if (!readShaderFile(passPaths[i].c_str(), fragmentSource)) { continue; }
+				if (!vertexChanged && fragmentSource == savedPassSources[i]) { continue; }
+
+				std::cout << "Detected change in " << passPaths[i] << ". Reloading..." << std::endl;
+				savedPassSources[i] = fragmentSource;
+
+				// a new buffer file turns the buffer on
+				if (!graph.passes[i].enabled)
+				{
+					graph.setEnabled(i, true);
+					editors[i].SetText(loadUserShaderSection(passPaths[i]));
+				}
+
+				graph.setChannelBindings(i, fragmentSource);
+
+				fileReloadTickets[i] = compiler.submit(buildShaderStages(vertexShaderSource, fragmentSource, passPaths[i]), i);
+			}
+		}
+
+		// Swap in finished builds, the old programs keep rendering until then
+		CompileResult compiled;
+		while (compiler.poll(compiled))
+		{
+			TextEditor& passEditor = editors[compiled.slot];
+			const char* passName = getRenderPassName(compiled.slot);
+
+			if (compiled.success)
+			{
+				// the tab may have been closed while it was compiling
+				if (graph.passes[compiled.slot].enabled)
+				{
+					graph.setProgram(compiled.slot, compiled.program, compiled.fragmentSource);
+				}
+				else
+				{
+					glDeleteProgram(compiled.program);
+				}
+
+				// Clear error markers if successful
+				passEditor.SetErrorMarkers(TextEditor::ErrorMarkers());
+
+				if (compiled.ticket == fileReloadTickets[compiled.slot])
+				{
+					timer = 0.0f;
+					timerActive = false; // restart paused
+					frameCount = 0;
+					graph.resetBuffers();
+					std::cout << passName << " reloaded successfully." << std::endl;
+				}
+				else
+				{
+					auto& d = compiled.diagnostics;
+					std::cout << "[Shader] " << passName << " compilation + link successful (";
+					if (d.stagesTimed) { std::cout << "compile " << d.compileMs << " ms, link " << d.linkMs << " ms"; }
+					else { std::cout << d.linkMs << " ms"; }
+					std::cout << (d.fromCache ? ", from cache" : "") << ").\n";
+				}
 			}
 			else
 			{
-				std::cout << "Failed to reload shader." << std::endl;
+				std::cout << "[Shader] " << passName << " compile FAILED:\n" << compiled.diagnostics.getErrors() << std::endl;
+
+				// Build ImGui error markers
+				auto fragment = compiled.diagnostics.getStage(GL_FRAGMENT_SHADER);
+				passEditor.SetErrorMarkers(fragment ? fragment->lineMap : TextEditor::ErrorMarkers());
 			}
-			lastWriteTime = currentWriteTime;
 		}
 
+		profiler.end(stageFilePolling);
+
 		if (timerActive) {
 			timer += deltaTime;  // Accumulate real time only when playing
 		}
@@ -399,6 +461,8 @@ int main()
 		glViewport(0, 0, width, height);
 		glClear(GL_COLOR_BUFFER_BIT);
 
+		profiler.begin(stageImGuiBuild);
+
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -432,7 +496,37 @@ int main()
 		ImGui::SameLine();
 		ImGui::Text("Time: %.2f", timer);
 		ImGui::SameLine();
-		ImGui::Text("| Resolution: %d x %d", width, height);
+		if (dynamicResolution.enabled)
+		{
+			ImGui::Text("| Resolution: %d x %d (%.0f%%)", width, height, dynamicResolution.getScale() * 100.0f);
+		}
+		else
+		{
+			ImGui::Text("| Resolution: %d x %d", width, height);
+		}
+		ImGui::SameLine();
+		ImGui::Text("| GPU: %.2f ms (shader %.2f, ui %.2f)", gpuTimer.getFrameMs(),
+			gpuTimer.getPassMs("Shader"), gpuTimer.getPassMs("ImGui"));
+		if (compiler.isBusy())
+		{
+			ImGui::SameLine();
+			ImGui::Text("| Compiling...");
+		}
+		if (accumulator.enabled)
+		{
+			ImGui::SameLine();
+			ImGui::Text("| Samples: %d%s", accumulator.getSampleCount(), accumulator.isConverged() ? " (done)" : "");
+		}
+		if (frameReused)
+		{
+			ImGui::SameLine();
+			ImGui::Text("| Static");
+		}
+		if (recorder.isOpen())
+		{
+			ImGui::SameLine();
+			ImGui::Text("| REC %lld frames, %lld dropped", recorder.getWrittenFrames(), droppedFrames);
+		}
 
 		float rightAlign = ImGui::GetContentRegionAvail().x - 120;
 		ImGui::SameLine(rightAlign);
@@ -441,6 +535,8 @@ int main()
 		{
 			timer = 0.0f;
 			timerActive = false; // restart paused
+			frameCount = 0;
+			graph.resetBuffers();
 		}
 
 		ImGui::SameLine();
@@ -454,7 +550,124 @@ int main()
 
 		ImGui::Begin("Fragment Shader Editor");
 
-		ImGui::Text("Editing: %s", fragmentShaderPath.c_str());
+		// One tab per pass, closing a buffer's tab turns the buffer off
+		if (ImGui::BeginTabBar("Passes"))
+		{
+			for (int i = 0; i < RenderPassCount; i++)
+			{
+				if (!graph.passes[i].enabled) { continue; }
+
+				bool open = true;
+				ImGuiTabItemFlags flags = i == selectPass ? ImGuiTabItemFlags_SetSelected : 0;
+				if (ImGui::BeginTabItem(getRenderPassName(i), i == PassImage ? nullptr : &open, flags))
+				{
+					currentPass = i;
+					ImGui::EndTabItem();
+				}
+
+				if (!open)
+				{
+					graph.setEnabled(i, false);
+					shaderDirty = true;
+					if (currentPass == i) { currentPass = PassImage; }
+				}
+			}
+			selectPass = -1;
+
+			if (ImGui::TabItemButton("+", ImGuiTabItemFlags_Trailing))
+			{
+				ImGui::OpenPopup("AddPass");
+			}
+			if (ImGui::BeginPopup("AddPass"))
+			{
+				for (int i = 0; i < PassImage; i++)
+				{
+					if (graph.passes[i].enabled || !ImGui::MenuItem(getRenderPassName(i))) { continue; }
+
+					graph.setEnabled(i, true);
+					if (editors[i].GetText().size() <= 1) { editors[i].SetText(defaultBufferCode); }
+
+					std::string fullShader = buildFullFragmentShader(editors[i].GetText(), graph.passes[i].channels, graph.passes[i].channelFiles);
+					compiler.submit(buildShaderStages(vertexShaderSource, fullShader, passPaths[i]), i);
+					selectPass = i;
+					shaderDirty = true;
+				}
+				ImGui::EndPopup();
+			}
+
+			ImGui::EndTabBar();
+		}
+
+		TextEditor& editor = editors[currentPass];
+
+		ImGui::Text("Editing: %s", passPaths[currentPass].c_str());
+
+		// Channel sources take effect right away, they are not part of the program
+		for (int c = 0; c < ChannelCount; c++)
+		{
+			int source = graph.passes[currentPass].channels[c];
+			const std::string& file = graph.passes[currentPass].channelFiles[c];
+			std::string label = "iChannel" + std::to_string(c);
+
+			std::string preview = source >= 0 ? getRenderPassName(source) : file.empty() ? "None" : file;
+			size_t uploaded = 0, total = 0;
+			bool resident = channelTextures.getResidency(textureLoader, currentPass, c, uploaded, total);
+			if (channelTextures.hasFailed(textureLoader, currentPass, c))
+			{
+				preview += " (failed)";
+			}
+			else if (resident && uploaded < total)
+			{
+				preview += " " + std::to_string(uploaded * 100 / total) + "%";
+			}
+
+			if (c > 0) { ImGui::SameLine(); }
+			ImGui::SetNextItemWidth(90);
+			if (ImGui::BeginCombo(label.c_str(), preview.c_str()))
+			{
+				if (ImGui::IsWindowAppearing())
+				{
+					// files next to the shader, looked up each time the menu opens
+					channelFileChoices.clear();
+					std::error_code error;
+					for (auto& entry : std::filesystem::directory_iterator(RESOURCES_PATH, error))
+					{
+						std::string name = entry.path().filename().string();
+						if (entry.is_regular_file() && isChannelFileName(name)) { channelFileChoices.push_back(name); }
+					}
+					std::sort(channelFileChoices.begin(), channelFileChoices.end());
+					channelFileChoices.push_back(AudioTestSignalName);
+				}
+
+				if (ImGui::Selectable("None", source < 0 && file.empty()))
+				{
+					graph.setChannel(currentPass, c, -1);
+					shaderDirty = true;
+				}
+				for (int b = 0; b < PassImage; b++)
+				{
+					if (ImGui::Selectable(getRenderPassName(b), source == b))
+					{
+						graph.setChannel(currentPass, c, b);
+						shaderDirty = true;
+					}
+				}
+				if (!channelFileChoices.empty()) { ImGui::Separator(); }
+				for (auto& name : channelFileChoices)
+				{
+					if (ImGui::Selectable(name.c_str(), name == file))
+					{
+						graph.setChannelFile(currentPass, c, name);
+						shaderDirty = true;
+					}
+				}
+				ImGui::EndCombo();
+			}
+			if (resident && ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("%s\n%.1f of %.1f MB on the GPU", file.c_str(), uploaded / 1048576.0, total / 1048576.0);
+			}
+		}
 		ImGui::Separator();
 
 		// Calculate size for the editor that leaves some room for buttons
@@ -467,12 +680,11 @@ int main()
 
 		bool ctrl = ImGui::GetIO().KeyCtrl;
 
+		bool saveShaderFromEditor = false;
+
 		if (ctrl && ImGui::IsKeyPressed(ImGuiKey_S)) {
 			// Ctrl+S -> Save file
-			std::ofstream out(fragmentShaderPath);
-			out << buildFullFragmentShader(editor.GetText());
-			out.close();
-			std::cout << "[Hotkey] Saved shader.\n";
+			saveShaderFromEditor = true;
 		}
 
 		if (ctrl && ImGui::IsKeyPressed(ImGuiKey_Enter)) {
@@ -481,7 +693,11 @@ int main()
 		}
 
 		// Editor widget
+		profiler.end(stageImGuiBuild);
+		profiler.begin(stageEditorRender);
 		editor.Render("ShaderEditor", avail);
+		profiler.end(stageEditorRender);
+		profiler.begin(stageImGuiBuild);
 
 		// Track changes
 		if (editor.IsTextChanged()) {
@@ -493,83 +709,343 @@ int main()
 		{
 			compileShaderFromEditor = false;
 
-			std::string editedCode = editor.GetText();
-			std::string fullShader = buildFullFragmentShader(editedCode);
+			// Build straight from the editor text, each pass is swapped in once it is linked.
+			// Unchanged passes come straight out of the program cache
+			for (int i = 0; i < RenderPassCount; i++)
+			{
+				if (!graph.passes[i].enabled) { continue; }
 
-			// 1. Write file back to disk
-			std::ofstream out(fragmentShaderPath);
-			out << fullShader;
-			out.close();
+				std::string fullShader = buildFullFragmentShader(editors[i].GetText(), graph.passes[i].channels, graph.passes[i].channelFiles);
+				compiler.submit(buildShaderStages(vertexShaderSource, fullShader, passPaths[i]), i);
+			}
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Save") || saveShaderFromEditor)
+		{
+			for (int i = 0; i < RenderPassCount; i++)
+			{
+				if (!graph.passes[i].enabled)
+				{
+					// a closed buffer, its file would turn it back on at the next start
+					std::error_code error;
+					if (!savedPassSources[i].empty() && std::filesystem::remove(passPaths[i], error))
+					{
+						std::cout << "Removed " << passPaths[i] << "\n";
+					}
+					savedPassSources[i].clear();
+					continue;
+				}
 
-			// 2. Compile fragment shader with error capture
-			GLuint newFrag;
-			std::string errors;
+				// our own write is not an external change
+				savedPassSources[i] = buildFullFragmentShader(editors[i].GetText(), graph.passes[i].channels, graph.passes[i].channelFiles);
+
+				std::ofstream out(passPaths[i]);
+				out << savedPassSources[i];
+				out.close();
+			}
+			shaderDirty = false;
+
+			std::cout << "[Hotkey] Saved shader.\n";
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Screenshot") || ImGui::IsKeyPressed(ImGuiKey_F12))
+		{
+			screenshotRequested = true;
+		}
 
-			if (!compileShaderWithErrors(GL_FRAGMENT_SHADER, fullShader, newFrag, errors))
+		ImGui::SameLine();
+		if (ImGui::Button(recorder.isOpen() ? "Stop Recording" : "Record"))
+		{
+			if (recorder.isOpen())
 			{
-				std::cout << "[Shader] Compile FAILED:\n" << errors << std::endl;
+				stopRecording();
+			}
+			else
+			{
+				VideoWriterOptions recordingOptions;
+				recordingOptions.output = "recording_" + std::to_string(recordingCount++) + ".y4m";
+				recordingOptions.width = width;
+				recordingOptions.height = height;
+				recordingOptions.fpsNumerator = 60;	// the swap interval, not measured
+
+				recordingFrames.init(width, height, 4);
+				droppedFrames = 0;
+				if (recorder.open(recordingOptions))
+				{
+					std::cout << "Recording to " << recordingOptions.output << "\n";
+				}
+				else
+				{
+					recordingFrames.clear();
+				}
+			}
+		}
 
-				// Build ImGui error markers
-				editor.SetErrorMarkers(buildErrorMarkers(errors));
-				continue;
+		ImGui::SameLine();
+		if (ImGui::Button("Profiler") || ImGui::IsKeyPressed(ImGuiKey_F3))
+		{
+			showProfiler = !showProfiler;
+		}
+
+		// heavy shaders drawn in one go can trip the driver's watchdog
+		bool splitDraws = graph.submitTileSize > 0;
+		if (ImGui::Checkbox("Split draws", &splitDraws))
+		{
+			graph.submitTileSize = splitDraws ? 256 : 0;
+		}
+
+		ImGui::SameLine();
+		ImGui::Checkbox("Accumulate", &accumulator.enabled);
+		if (accumulator.enabled)
+		{
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(100);
+			if (ImGui::InputInt("Samples", &accumulator.sampleTarget, 256, 1024))
+			{
+				accumulator.sampleTarget = std::max(accumulator.sampleTarget, 0);
 			}
+		}
+
+		ImGui::SameLine();
+		ImGui::Checkbox("Skip static frames", &frameCache.enabled);
 
-			// Clear error markers if successful
-			editor.SetErrorMarkers(TextEditor::ErrorMarkers());
+		ImGui::SameLine();
+		if (ImGui::Checkbox("Dynamic resolution", &dynamicResolution.enabled))
+		{
+			frameCache.invalidate();
+		}
+		if (dynamicResolution.enabled)
+		{
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(140);
+			ImGui::SliderFloat("Budget", &dynamicResolution.targetMs, 4.0f, 50.0f, "%.1f ms");
 
-			// 3. Link using your Shader class
-			if (s.loadShaderProgramFromFile(RESOURCES_PATH "vertex.vert", fragmentShaderPath.c_str()))
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(100);
+			if (ImGui::BeginCombo("Upscale", getUpscaleFilterName(dynamicResolution.filter)))
 			{
-				std::cout << "[Shader] Compilation + link successful.\n";
-				s.bind();
-				lastWriteTime = getFileLastWriteTime(fragmentShaderPath);
+				for (int f = 0; f < UpscaleFilterCount; f++)
+				{
+					if (ImGui::Selectable(getUpscaleFilterName((UpscaleFilter)f), dynamicResolution.filter == f))
+					{
+						dynamicResolution.filter = (UpscaleFilter)f;
+						frameCache.invalidate();
+					}
+				}
+				ImGui::EndCombo();
 			}
 		}
 
 		ImGui::End();
 
+		if (showProfiler) { profiler.drawOverlay(&showProfiler); }
+
+		profiler.end(stageImGuiBuild);
+
+		profiler.begin(stageTextureUpload);
+		textureLoader.update();
+		channelTextures.update(graph, textureLoader, RESOURCES_PATH, timer);
+		profiler.end(stageTextureUpload);
+
 		// Shader updates
-		s.bind();
-
-		if (u_resolution != -1) glUniform2f(u_resolution, (float)width, (float)height);
-		if (u_time != -1) glUniform1f(u_time, timer);
-		if (u_time_delta != -1) glUniform1f(u_time_delta, deltaTime);
-		if (u_frame_rate != -1) glUniform1f(u_frame_rate, 1.0f / deltaTime);
-		if (u_frame != -1) glUniform1i(u_frame, frameCount);
-		if (u_mouse != -1)
+		profiler.begin(stageUniformUpdate);
+		dynamicResolution.update(gpuTimer, getRenderPassName(PassImage));
+
+		BuiltinUniformValues inputs;
+		inputs.resolution[0] = (float)width;
+		inputs.resolution[1] = (float)height;
+		inputs.resolution[2] = 1.0f;
+		inputs.time = timer;
+		inputs.timeDelta = deltaTime;
+		inputs.frameRate = 1.0f / deltaTime;
+		inputs.frame = frameCount;
 		{
 			float mouseX = (float)lastMouseX;
 			float mouseY = (float)(height - lastMouseY); // Invert Y for shader coordinates
-			glUniform4f(u_mouse, mouseX, mouseY,
-				glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS ? mouseX : 0.0f,
-				glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS ? mouseY : 0.0f);
+			bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+			inputs.mouse[0] = mouseX;
+			inputs.mouse[1] = mouseY;
+			inputs.mouse[2] = pressed ? mouseX : 0.0f;
+			inputs.mouse[3] = pressed ? mouseY : 0.0f;
 		}
-		if (u_date != -1)
+		if (graph.uses(UniformDate))
 		{
 			time_t now = time(0);
-			tm* ltm = localtime(&now);
-			glUniform4f(u_date,
-				(float)(ltm->tm_year + 1900),
-				(float)(ltm->tm_mon + 1),
-				(float)ltm->tm_mday,
-				(float)(ltm->tm_hour * 3600 + ltm->tm_min * 60 + ltm->tm_sec));
+			if (now != dateSecond)
+			{
+				dateSecond = now;
+				tm* ltm = localtime(&now);
+				date[0] = (float)(ltm->tm_year + 1900);
+				date[1] = (float)(ltm->tm_mon + 1);
+				date[2] = (float)ltm->tm_mday;
+				date[3] = (float)(ltm->tm_hour * 3600 + ltm->tm_min * 60 + ltm->tm_sec);
+			}
+			std::copy(date, date + 4, inputs.date);
+		}
+		profiler.end(stageUniformUpdate);
+
+		profiler.begin(stageDraw);
+
+		// buffers in dependency order, then the image pass into the window or,
+		// scaled down, into the offscreen target that is then stretched over it.
+		// Accumulation always renders at full size, a changing scale would keep
+		// starting it over. A minimized window has a 0x0 framebuffer and gets nothing
+		if (width > 0 && height > 0)
+		{
+			ImageTarget image = { 0, width, height };
+			bool drawFrame = true;
+			if (accumulator.enabled)
+			{
+				// the cursor only counts when a pass reads iMouse
+				const float noMouse[4] = {};
+				drawFrame = accumulator.begin(width, height, graph.uses(UniformMouse) ? inputs.mouse : noMouse, graph.getVersion());
+				image.framebuffer = accumulator.getFramebuffer();
+				inputs.sampleCount = accumulator.getSampleCount();
+			}
+			else if (dynamicResolution.enabled)
+			{
+				image.framebuffer = dynamicResolution.getFramebuffer(width, height);
+				dynamicResolution.getRenderSize(width, height, image.width, image.height);
+			}
+
+			// the accumulator already stops drawing once converged
+			frameReused = !accumulator.enabled && frameCache.isCurrent(graph, inputs, width, height, image.width, image.height);
+
+			if (frameReused)
+			{
+				frameCache.present(0);
+			}
+			else
+			{
+				if (drawFrame)
+				{
+					gpuTimer.beginPass("Shader");
+					if (accumulator.enabled)
+					{
+						// only the image pass blends into the average
+						graph.renderBuffers(inputs, width, height, &gpuTimer);
+						accumulator.beginSample();
+						graph.renderImage(inputs, image, &gpuTimer);
+					}
+					else
+					{
+						graph.render(inputs, width, height, image, &gpuTimer);
+					}
+					gpuTimer.endPass();
+				}
+
+				if (accumulator.enabled)
+				{
+					if (drawFrame) { accumulator.end(); }
+					accumulator.present(0, width, height);
+					frameCache.invalidate();
+				}
+				else
+				{
+					if (dynamicResolution.enabled)
+					{
+						gpuTimer.beginPass("Upscale");
+						dynamicResolution.present(0, width, height, quad);
+						gpuTimer.endPass();
+					}
+					frameCache.store(graph, inputs, 0, width, height, image.width, image.height);
+				}
+			}
+		}
+
+		// Grab the shader output before ImGui draws on top of it
+		if (screenshotRequested)
+		{
+			if ((screenshots.getWidth() != width || screenshots.getHeight() != height) && !screenshots.hasPending())
+			{
+				screenshots.init(width, height);
+			}
+			if (screenshots.getWidth() == width && screenshots.getHeight() == height && screenshots.capture(screenshotCount))
+			{
+				screenshotCount++;
+				screenshotRequested = false;
+			}
 		}
-		
 
-		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+		if (recorder.isOpen())
+		{
+			if (width != recordingFrames.getWidth() || height != recordingFrames.getHeight())
+			{
+				std::cout << "Window resized, stopping the recording.\n";
+				stopRecording();
+			}
+			else
+			{
+				if (!recordingFrames.capture(frameCount)) { droppedFrames++; }
+
+				ReadbackFrame f;
+				while (recordingFrames.acquire(f))
+				{
+					if (!recorder.submit(f, recordingFrames))
+					{
+						recordingFrames.release(f);
+						droppedFrames++;
+					}
+				}
+			}
+		}
+
+		ReadbackFrame shot;
+		while (screenshots.acquire(shot))
+		{
+			std::string path = "screenshot_" + std::to_string(shot.tag) + ".ppm";
+			if (writePPM(path, shot.width, shot.height, shot.pixels, shot.stride))
+			{
+				std::cout << "Saved " << path << "\n";
+			}
+			else
+			{
+				std::cout << "Error writing " << path << "\n";
+			}
+			screenshots.release(shot);
+		}
+
+		profiler.end(stageDraw);
 
 		// ImGui render
+		profiler.begin(stageImGuiRender);
 		ImGui::Render();
 		int display_w, display_h = 0;
 		glfwGetFramebufferSize(window, &display_w, &display_h);
 		glViewport(0, 0, display_w, display_h);
+		gpuTimer.beginPass("ImGui");
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		gpuTimer.endPass();
+		gpuTimer.endFrame();
+		profiler.end(stageImGuiRender);
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		{
+			ProfileScope scope(profiler, stageSwap);
+			glfwSwapBuffers(window);
+		}
+		{
+			ProfileScope scope(profiler, stageEventPoll);
+			glfwPollEvents();
+		}
+
+		profiler.endFrame();
 	}
 
+	if (recorder.isOpen()) { stopRecording(); }
+	gpuTimer.clear();
+	watcher.stop();
+	compiler.shutdown();
+	frameCache.clear();
+	accumulator.clear();
+	dynamicResolution.clear();
+	channelTextures.clear(textureLoader);
+	textureLoader.clear();
+	graph.clear();
+	screenshots.clear();
+	quad.clear();
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
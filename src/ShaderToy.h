@@ -7,4 +7,5 @@
 #include <chrono>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
\ No newline at end of file
+#include <sstream>
+#include <algorithm>
\ No newline at end of file
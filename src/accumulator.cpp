@@ -0,0 +1,88 @@
+#include <accumulator.h>
+#include <algorithm>
+#include <iostream>
+
+void Accumulator::clear()
+{
+	if (fbo) { glDeleteFramebuffers(1, &fbo); }
+	if (texture) { glDeleteTextures(1, &texture); }
+	fbo = texture = 0;
+	width = height = 0;
+	samples = 0;
+}
+
+bool Accumulator::begin(int width, int height, const float mouse[4], unsigned int graphVersion)
+{
+	if (width <= 0 || height <= 0) { return false; }
+
+	if (width != this->width || height != this->height)
+	{
+		if (fbo) { glDeleteFramebuffers(1, &fbo); }
+		if (texture) { glDeleteTextures(1, &texture); }
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Accumulation framebuffer is incomplete\n";
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		this->width = width;
+		this->height = height;
+		restart();
+	}
+
+	if (graphVersion != lastGraphVersion || !std::equal(mouse, mouse + 4, lastMouse))
+	{
+		lastGraphVersion = graphVersion;
+		std::copy(mouse, mouse + 4, lastMouse);
+		restart();
+	}
+
+	return !isConverged();
+}
+
+void Accumulator::restart()
+{
+	samples = 0;
+
+	// the first sample's weight is 1 but dst * 0 is still NaN for NaN garbage
+	if (texture)
+	{
+		const float zero[4] = {};
+		glClearTexImage(texture, 0, GL_RGBA, GL_FLOAT, zero);
+	}
+}
+
+void Accumulator::beginSample()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+	glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / (samples + 1));
+}
+
+void Accumulator::end()
+{
+	glDisable(GL_BLEND);
+	samples++;
+}
+
+void Accumulator::present(GLuint framebuffer, int width, int height)
+{
+	if (!fbo) { return; }
+
+	// float to unorm, values past 1 are clamped
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, this->width, this->height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
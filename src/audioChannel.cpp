@@ -0,0 +1,391 @@
+#include <audioChannel.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHADERTOY_SSE2
+#include <emmintrin.h>
+#endif
+
+// what the browser's analyser gives shadertoy.com
+static const float smoothing = 0.8f;
+static const float minDecibels = -100.0f;
+static const float maxDecibels = -30.0f;
+
+static const double pi = 3.14159265358979323846;
+
+bool isAudioChannelName(const std::string& name)
+{
+	if (name == AudioTestSignalName) { return true; }
+	if (name.size() < 4) { return false; }
+
+	std::string extension = name.substr(name.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension == ".wav";
+}
+
+// Bit reversal and twiddles for one FFT size. The twiddles of the stage
+// combining spans of half are stored at [half, 2 * half), in order, so the
+// butterflies of a stage read them as one contiguous run.
+struct FFTTables
+{
+	std::vector<int> reversed;
+	std::vector<float> cosines;
+	std::vector<float> sines;
+
+	explicit FFTTables(int n) : reversed(n), cosines(n), sines(n)
+	{
+		int bits = 0;
+		while ((1 << bits) < n) { bits++; }
+		for (int i = 0; i < n; i++)
+		{
+			int r = 0;
+			for (int b = 0; b < bits; b++) { r |= ((i >> b) & 1) << (bits - 1 - b); }
+			reversed[i] = r;
+		}
+
+		for (int half = 1; half < n; half *= 2)
+		{
+			for (int j = 0; j < half; j++)
+			{
+				double angle = -pi * j / half;
+				cosines[half + j] = (float)std::cos(angle);
+				sines[half + j] = (float)std::sin(angle);
+			}
+		}
+	}
+};
+
+// In place radix 2 FFT over split real and imaginary arrays, input already in
+// bit reversed order. Stages with spans of 4 or more do 4 butterflies at once.
+static void transform(float* re, float* im, int n, const FFTTables& tables)
+{
+	for (int half = 1; half < n; half *= 2)
+	{
+		const float* wr = &tables.cosines[half];
+		const float* wi = &tables.sines[half];
+
+		for (int start = 0; start < n; start += 2 * half)
+		{
+			float* ar = re + start;
+			float* ai = im + start;
+			float* br = ar + half;
+			float* bi = ai + half;
+			int j = 0;
+
+#ifdef SHADERTOY_SSE2
+			for (; j + 4 <= half; j += 4)
+			{
+				__m128 cr = _mm_loadu_ps(wr + j);
+				__m128 ci = _mm_loadu_ps(wi + j);
+				__m128 xr = _mm_loadu_ps(br + j);
+				__m128 xi = _mm_loadu_ps(bi + j);
+				__m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+				__m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+				__m128 yr = _mm_loadu_ps(ar + j);
+				__m128 yi = _mm_loadu_ps(ai + j);
+				_mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+				_mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+				_mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+				_mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+			}
+#endif
+			for (; j < half; j++)
+			{
+				float tr = br[j] * wr[j] - bi[j] * wi[j];
+				float ti = br[j] * wi[j] + bi[j] * wr[j];
+				br[j] = ar[j] - tr;
+				bi[j] = ai[j] - ti;
+				ar[j] += tr;
+				ai[j] += ti;
+			}
+		}
+	}
+}
+
+static uint32_t readU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t readU16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+bool AudioChannel::open(const std::string& path, bool useWorker)
+{
+	close();
+
+	if (path == AudioTestSignalName)
+	{
+		testSignal = true;
+		sampleRate = 44100;
+	}
+	else if (!openWav(path)) { return false; }
+
+	std::fill(std::begin(smoothed), std::end(smoothed), 0.0f);
+	lastAnalysedTime = -1;
+	lastTime = -1.0f;
+	back = 0;
+	front = 1;
+	middle = 2;
+
+	// silence until the first analysis is in
+	Analysis silence;
+	memset(silence.texels, 0, TextureWidth);
+	memset(silence.texels + TextureWidth, 128, TextureWidth);
+	for (Analysis& slot : slots) { slot = silence; }
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, TextureWidth, 2, 0, GL_RED, GL_UNSIGNED_BYTE, silence.texels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (useWorker)
+	{
+		running = true;
+		worker = std::thread(&AudioChannel::workerLoop, this);
+	}
+	return true;
+}
+
+bool AudioChannel::openWav(const std::string& path)
+{
+	if (!file.open(path))
+	{
+		std::cout << "Failed to open audio file " << path << std::endl;
+		return false;
+	}
+
+	const unsigned char* data = file.getData();
+	size_t size = file.getSize();
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+	{
+		std::cout << "Not a WAV file: " << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	int format = 0;
+	int bits = 0;
+	int blockAlign = 0;
+	size_t dataSize = 0;
+
+	// chunks are padded to even sizes, anything but the format and the samples is skipped
+	size_t at = 12;
+	while (at + 8 <= size)
+	{
+		const unsigned char* chunk = data + at;
+		size_t length = std::min((size_t)readU32(chunk + 4), size - at - 8);
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && length >= 16)
+		{
+			format = readU16(chunk + 8);
+			channels = readU16(chunk + 10);
+			sampleRate = (int)readU32(chunk + 12);
+			blockAlign = readU16(chunk + 20);
+			bits = readU16(chunk + 22);
+
+			// WAVE_FORMAT_EXTENSIBLE keeps the real format in its sub format GUID
+			if (format == 0xFFFE && length >= 40) { format = readU16(chunk + 32); }
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			samples = chunk + 8;
+			dataSize = length;
+		}
+		at += 8 + length + (length & 1);
+	}
+
+	bool supported = (format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) || (format == 3 && bits == 32);
+	if (!samples || !supported || channels <= 0 || sampleRate <= 0 || blockAlign < channels * bits / 8)
+	{
+		std::cout << "Unsupported WAV format in " << path << " (format " << format << ", " << bits << " bits)" << std::endl;
+		file.close();
+		samples = nullptr;
+		return false;
+	}
+
+	bytesPerSample = bits / 8;
+	floatSamples = format == 3;
+	frameBytes = blockAlign;
+	frameCount = (long long)(dataSize / blockAlign);
+
+	// the whole file is small next to a volume, have the OS read it now
+	file.prefetch(samples - data, dataSize);
+	return true;
+}
+
+void AudioChannel::close()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(timeMutex);
+			running = false;
+		}
+		timeChanged.notify_one();
+		worker.join();
+	}
+
+	if (texture)
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+
+	file.close();
+	samples = nullptr;
+	frameCount = 0;
+	channels = 0;
+	testSignal = false;
+}
+
+float AudioChannel::getSample(long long frame) const
+{
+	if (testSignal)
+	{
+		double t = (double)frame / sampleRate;
+		double pulse = 0.6 + 0.4 * std::sin(2 * pi * 2 * t);
+		return (float)(pulse * (0.5 * std::sin(2 * pi * 220 * t) + 0.25 * std::sin(2 * pi * 880 * t)));
+	}
+
+	if (frame < 0 || frame >= frameCount) { return 0.0f; }
+
+	const unsigned char* p = samples + (size_t)frame * frameBytes;
+	float sum = 0.0f;
+	for (int c = 0; c < channels; c++, p += bytesPerSample)
+	{
+		switch (bytesPerSample)
+		{
+		case 1: sum += (p[0] - 128) / 128.0f; break;
+		case 2: sum += (int16_t)readU16(p) / 32768.0f; break;
+		case 3: sum += (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f; break;
+		default:
+			if (floatSamples)
+			{
+				float f;
+				memcpy(&f, p, 4);
+				sum += f;
+			}
+			else { sum += (int32_t)readU32(p) / 2147483648.0f; }
+			break;
+		}
+	}
+	return sum / channels;
+}
+
+// The fftSize samples up to time, Blackman windowed, into the spectrum row as
+// smoothed decibels, and the last TextureWidth of them into the waveform row.
+void AudioChannel::analyse(double time, Analysis& out)
+{
+	static const FFTTables tables(fftSize);
+	static const std::vector<float> window = []()
+	{
+		std::vector<float> w(fftSize);
+		for (int i = 0; i < fftSize; i++)
+		{
+			double x = 2 * pi * i / fftSize;
+			w[i] = (float)(0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2 * x));
+		}
+		return w;
+	}();
+
+	// going back in time, a reset or a seek, starts the smoothing over
+	if (time < lastAnalysedTime - 0.1) { std::fill(std::begin(smoothed), std::end(smoothed), 0.0f); }
+	lastAnalysedTime = time;
+
+	float re[fftSize];
+	float im[fftSize];
+	float wave[TextureWidth];
+	long long first = (long long)std::floor(time * sampleRate) - fftSize;
+	for (int i = 0; i < fftSize; i++)
+	{
+		float s = getSample(first + i);
+		if (i >= fftSize - TextureWidth) { wave[i - (fftSize - TextureWidth)] = s; }
+		re[tables.reversed[i]] = s * window[i];
+		im[i] = 0.0f;
+	}
+
+	transform(re, im, fftSize, tables);
+
+	for (int k = 0; k < fftSize / 2; k++)
+	{
+		float magnitude = std::sqrt(re[k] * re[k] + im[k] * im[k]) / fftSize;
+		smoothed[k] = smoothing * smoothed[k] + (1.0f - smoothing) * magnitude;
+	}
+
+	for (int k = 0; k < TextureWidth; k++)
+	{
+		float db = smoothed[k] > 0.0f ? 20.0f * std::log10(smoothed[k]) : minDecibels;
+		float v = 255.0f * (db - minDecibels) / (maxDecibels - minDecibels);
+		out.texels[k] = (unsigned char)std::min(std::max(v, 0.0f), 255.0f);
+
+		float w = 128.0f * (1.0f + wave[k]);
+		out.texels[TextureWidth + k] = (unsigned char)std::min(std::max(w, 0.0f), 255.0f);
+	}
+}
+
+void AudioChannel::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(timeMutex);
+
+	double analysed = -1;
+	while (true)
+	{
+		timeChanged.wait(lock, [&] { return !running || expectedTime != analysed; });
+		if (!running) { return; }
+
+		double time = expectedTime;
+		lock.unlock();
+
+		analyse(time, slots[back]);
+		analysed = time;
+		back = middle.exchange(back | freshBit) & ~freshBit;
+
+		lock.lock();
+	}
+}
+
+void AudioChannel::upload(const Analysis& a)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TextureWidth, 2, GL_RED, GL_UNSIGNED_BYTE, a.texels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	revision++;
+}
+
+bool AudioChannel::update(float time)
+{
+	if (!texture) { return false; }
+
+	if (!worker.joinable())
+	{
+		if (time == lastAnalysedTime) { return false; }
+		analyse(time, slots[front]);
+		upload(slots[front]);
+		return true;
+	}
+
+	// Work out when the next frame will be, at the same step as this one. When
+	// paused, or after a jump, that is now.
+	float step = time - lastTime;
+	double next = (lastTime >= 0.0f && step > 0.0f && step < 0.25f) ? time + step : time;
+	lastTime = time;
+
+	bool moved = false;
+	{
+		std::lock_guard<std::mutex> lock(timeMutex);
+		moved = next != expectedTime;
+		expectedTime = next;
+	}
+	// paused, the worker stays asleep
+	if (moved) { timeChanged.notify_one(); }
+
+	if (!(middle.load() & freshBit)) { return false; }
+	front = middle.exchange(front) & ~freshBit;
+	upload(slots[front]);
+	return true;
+}
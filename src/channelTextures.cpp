@@ -0,0 +1,116 @@
+#include <channelTextures.h>
+#include <filesystem>
+
+static std::string resolvePath(const std::string& folder, const std::string& file)
+{
+	if (file == AudioTestSignalName) { return file; }
+
+	std::filesystem::path path(file);
+	return path.is_absolute() ? file : (std::filesystem::path(folder) / path).string();
+}
+
+void ChannelTextures::update(RenderGraph& graph, TextureLoader& loader, const std::string& folder, float time)
+{
+	for (int pass = 0; pass < RenderPassCount; pass++)
+	{
+		const RenderPass& p = graph.passes[pass];
+		for (int c = 0; c < ChannelCount; c++)
+		{
+			const std::string& file = p.enabled ? p.channelFiles[c] : std::string();
+			if (file == files[pass][c]) { continue; }
+
+			loader.release(handles[pass][c]);
+			handles[pass][c] = -1;
+			audioPaths[pass][c].clear();
+			files[pass][c] = file;
+
+			if (file.empty()) { continue; }
+			if (isAudioChannelName(file)) { audioPaths[pass][c] = resolvePath(folder, file); }
+			else { handles[pass][c] = loader.request(resolvePath(folder, file)); }
+		}
+	}
+
+	// open the audio sources newly named, close the ones nothing reads anymore
+	std::map<std::string, std::unique_ptr<AudioChannel>> kept;
+	for (int pass = 0; pass < RenderPassCount; pass++)
+	{
+		for (int c = 0; c < ChannelCount; c++)
+		{
+			const std::string& path = audioPaths[pass][c];
+			if (path.empty() || kept.count(path)) { continue; }
+
+			auto found = audio.find(path);
+			if (found != audio.end())
+			{
+				kept[path] = std::move(found->second);
+				continue;
+			}
+
+			std::unique_ptr<AudioChannel> channel(new AudioChannel());
+			if (!channel->open(path, !synchronousAudio)) { channel.reset(); }
+			kept[path] = std::move(channel);
+		}
+	}
+	audio.swap(kept);
+
+	for (auto& source : audio)
+	{
+		if (source.second) { source.second->update(time); }
+	}
+
+	for (int pass = 0; pass < RenderPassCount; pass++)
+	{
+		for (int c = 0; c < ChannelCount; c++)
+		{
+			ChannelTexture texture;
+			if (!audioPaths[pass][c].empty())
+			{
+				const AudioChannel* channel = audio[audioPaths[pass][c]].get();
+				if (channel)
+				{
+					texture.id = channel->getTexture();
+					texture.size[0] = AudioChannel::TextureWidth;
+					texture.size[1] = 2;
+					texture.size[2] = 1;
+					texture.revision = channel->getRevision();
+				}
+			}
+			else
+			{
+				loader.getTexture(handles[pass][c], texture.id, texture.target, texture.size);
+			}
+			graph.setChannelTexture(pass, c, texture);
+		}
+	}
+}
+
+void ChannelTextures::clear(TextureLoader& loader)
+{
+	for (int pass = 0; pass < RenderPassCount; pass++)
+	{
+		for (int c = 0; c < ChannelCount; c++)
+		{
+			loader.release(handles[pass][c]);
+			handles[pass][c] = -1;
+			files[pass][c].clear();
+			audioPaths[pass][c].clear();
+		}
+	}
+	audio.clear();
+}
+
+bool ChannelTextures::hasFailed(const TextureLoader& loader, int pass, int channel) const
+{
+	const std::string& path = audioPaths[pass][channel];
+	if (!path.empty())
+	{
+		auto found = audio.find(path);
+		return found != audio.end() && !found->second;
+	}
+	return loader.hasFailed(handles[pass][channel]);
+}
+
+bool ChannelTextures::getResidency(const TextureLoader& loader, int pass, int channel, size_t& uploaded, size_t& total) const
+{
+	return loader.getResidency(handles[pass][channel], uploaded, total);
+}
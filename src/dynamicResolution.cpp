@@ -0,0 +1,195 @@
+#include <dynamicResolution.h>
+#include <algorithm>
+#include <cmath>
+
+static const char* const upscaleVertexSource =
+R"(#version 450 core
+
+layout(location = 0) in vec3 in_pos;
+
+out vec2 v_uv;
+
+void main()
+{
+    gl_Position = vec4(in_pos, 1.0);
+    v_uv = in_pos.xy * 0.5 + 0.5;
+}
+)";
+
+static const char* const upscaleFragmentSource =
+R"(#version 450 core
+
+in vec2 v_uv;
+layout(location = 0) out vec4 fragColor;
+
+uniform sampler2D u_source;
+uniform vec2 u_sourceSize;	// rendered part of the texture, in texels
+uniform vec2 u_sourceScale;	// rendered part of the texture, in texture coordinates
+uniform float u_sharpness;	// 0 for plain bilinear
+
+void main()
+{
+    vec2 texel = u_sourceScale / u_sourceSize;
+
+    // keep the filter off the texels past the rendered area
+    vec2 uv = clamp(v_uv * u_sourceScale, texel * 0.5, u_sourceScale - texel * 0.5);
+    vec3 c = texture(u_source, uv).rgb;
+
+    if (u_sharpness > 0.0)
+    {
+        // unsharp mask over the neighbouring texels, clamped to their range so edges don't ring
+        vec3 n = texture(u_source, uv + vec2(0.0, texel.y)).rgb;
+        vec3 s = texture(u_source, uv - vec2(0.0, texel.y)).rgb;
+        vec3 e = texture(u_source, uv + vec2(texel.x, 0.0)).rgb;
+        vec3 w = texture(u_source, uv - vec2(texel.x, 0.0)).rgb;
+
+        vec3 lo = min(c, min(min(n, s), min(e, w)));
+        vec3 hi = max(c, max(max(n, s), max(e, w)));
+        c = clamp(c + u_sharpness * (4.0 * c - n - s - e - w), lo, hi);
+    }
+
+    fragColor = vec4(c, 1.0);
+}
+)";
+
+const char* getUpscaleFilterName(UpscaleFilter filter)
+{
+	switch (filter)
+	{
+	case UpscaleBilinear: return "Bilinear";
+	case UpscaleSharpen: return "Sharpen";
+	default: return "";
+	}
+}
+
+bool DynamicResolution::init()
+{
+	clear();
+
+	if (!upscale.loadShaderProgramFromData(upscaleVertexSource, upscaleFragmentSource))
+	{
+		return false;
+	}
+
+	sourceSizeLocation = upscale.getUniform("u_sourceSize");
+	sourceScaleLocation = upscale.getUniform("u_sourceScale");
+	sharpnessLocation = upscale.getUniform("u_sharpness");
+	glProgramUniform1i(upscale.id, upscale.getUniform("u_source"), 0);
+	return true;
+}
+
+void DynamicResolution::clear()
+{
+	upscale.clear();
+	if (fbo) { glDeleteFramebuffers(1, &fbo); }
+	if (texture) { glDeleteTextures(1, &texture); }
+	fbo = texture = 0;
+	targetWidth = targetHeight = 0;
+
+	scale = maxScale;
+	lastSampledFrame = -1;
+	fullScaleMs = 0;
+}
+
+void DynamicResolution::update(const GpuTimer& timer, const char* imagePass)
+{
+	long long frameNumber = timer.getFrameNumber();
+
+	if (!enabled)
+	{
+		scale = maxScale;
+		lastSampledFrame = -1;
+		fullScaleMs = 0;
+		history[frameNumber % historySize] = scale;
+		return;
+	}
+
+	const GpuTimer::Pass* image = timer.findPass(imagePass);
+	const GpuTimer::Pass& frame = timer.getFrame();
+
+	// only a new result for a frame we still know the scale of, with the frame
+	// total from the same frame
+	if (image && image->lastMs > 0 && image->lastFrame > lastSampledFrame &&
+		image->lastFrame == frame.lastFrame && frameNumber - image->lastFrame < historySize)
+	{
+		lastSampledFrame = image->lastFrame;
+
+		float measuredScale = history[image->lastFrame % historySize];
+		double costMs = image->lastMs / (measuredScale * measuredScale);
+		fullScaleMs = fullScaleMs > 0 ? fullScaleMs + (costMs - fullScaleMs) * 0.25 : costMs;
+
+		double fixedMs = std::max(0.0, frame.lastMs - image->lastMs);
+		double budgetMs = std::max(targetMs - fixedMs, targetMs * 0.1);
+
+		float wanted = (float)std::sqrt(budgetMs / fullScaleMs);
+		wanted = std::min(std::max(wanted, minScale), maxScale);
+
+		// small steps aren't worth the image shimmering
+		if (std::fabs(wanted - scale) > 0.02f || wanted == minScale || wanted == maxScale)
+		{
+			scale = wanted;
+		}
+	}
+
+	history[frameNumber % historySize] = scale;
+}
+
+void DynamicResolution::getRenderSize(int width, int height, int& renderWidth, int& renderHeight) const
+{
+	float s = getScale();
+	renderWidth = std::max(1, std::min(width, (int)(width * s + 0.5f)));
+	renderHeight = std::max(1, std::min(height, (int)(height * s + 0.5f)));
+}
+
+GLuint DynamicResolution::getFramebuffer(int width, int height)
+{
+	// no storage can be made for it, and 0x0 would match an empty target
+	if (width <= 0 || height <= 0) { return 0; }
+
+	if (width == targetWidth && height == targetHeight && fbo) { return fbo; }
+
+	if (fbo) { glDeleteFramebuffers(1, &fbo); }
+	if (texture) { glDeleteTextures(1, &texture); }
+
+	// sized for scale 1, lower scales only use a corner so changing it costs nothing
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	targetWidth = width;
+	targetHeight = height;
+	return fbo;
+}
+
+void DynamicResolution::present(GLuint framebuffer, int width, int height, FullscreenQuad& quad)
+{
+	if (!texture) { return; }
+
+	int renderWidth = 0, renderHeight = 0;
+	getRenderSize(targetWidth, targetHeight, renderWidth, renderHeight);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	upscale.bind();
+	glUniform2f(sourceSizeLocation, (float)renderWidth, (float)renderHeight);
+	glUniform2f(sourceScaleLocation, (float)renderWidth / targetWidth, (float)renderHeight / targetHeight);
+	glUniform1f(sharpnessLocation, filter == UpscaleSharpen ? 0.25f : 0.0f);
+
+	quad.draw();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
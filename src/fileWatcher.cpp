@@ -0,0 +1,254 @@
+#include <fileWatcher.h>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#include <cstring>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// the fallback watcher has to stat, so it does it rarely
+static const std::chrono::milliseconds statInterval(250);
+
+static bool splitPath(const std::string& path, std::string& directory, std::string& name)
+{
+	// absolute() needs the working directory, which can be gone
+	std::error_code error;
+	std::filesystem::path p = std::filesystem::absolute(path, error);
+	if (error)
+	{
+		std::cout << "Error resolving " << path << ": " << error.message() << "\n";
+		return false;
+	}
+
+	p = p.lexically_normal();
+	directory = p.parent_path().string();
+	name = p.filename().string();
+	return true;
+}
+
+static long long getLastWrite(const std::string& path)
+{
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error) { return 0; }
+	return (long long)time.time_since_epoch().count();
+}
+
+bool FileWatcher::start(int debounceMs)
+{
+	if (running) { return true; }
+
+	debounce = std::chrono::milliseconds(debounceMs);
+
+#ifdef __linux__
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notifyFd < 0)
+	{
+		std::cout << "Error starting inotify: " << strerror(errno) << "\n";
+		return false;
+	}
+
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakeFd < 0)
+	{
+		std::cout << "Error creating file watcher eventfd: " << strerror(errno) << "\n";
+		close(notifyFd);
+		notifyFd = -1;
+		return false;
+	}
+#endif
+
+	running = true;
+	thread = std::thread(&FileWatcher::threadLoop, this);
+	return true;
+}
+
+void FileWatcher::stop()
+{
+	if (!running) { return; }
+
+	running = false;
+
+#ifdef __linux__
+	uint64_t one = 1;
+	(void)write(wakeFd, &one, sizeof(one));
+#endif
+
+	thread.join();
+
+#ifdef __linux__
+	close(notifyFd);
+	close(wakeFd);
+	notifyFd = -1;
+	wakeFd = -1;
+	directoryWatches.clear();
+#endif
+}
+
+int FileWatcher::addFile(const std::string& path)
+{
+	WatchedFile file;
+	file.path = path;
+	if (!splitPath(path, file.directory, file.name)) { return -1; }
+	file.lastWrite = getLastWrite(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+#ifdef __linux__
+	// Editors often save by writing a temp file and renaming it over the original,
+	// which drops a watch on the file itself, so the directory is watched instead.
+	bool watched = std::any_of(directoryWatches.begin(), directoryWatches.end(),
+		[&](const std::pair<int, std::string>& w) { return w.second == file.directory; });
+
+	if (!watched)
+	{
+		if (notifyFd < 0)
+		{
+			std::cout << "File watcher is not running, can't watch " << path << "\n";
+			return -1;
+		}
+
+		int wd = inotify_add_watch(notifyFd, file.directory.c_str(),
+			IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_ATTRIB);
+		if (wd < 0)
+		{
+			std::cout << "Error watching " << file.directory << ": " << strerror(errno) << "\n";
+			return -1;
+		}
+
+		directoryWatches.push_back({ wd, file.directory });
+	}
+#endif
+
+	files.push_back(std::move(file));
+	return (int)files.size() - 1;
+}
+
+void FileWatcher::markChanged(const std::string& directory, const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto& f : files)
+	{
+		if (f.name == name && f.directory == directory)
+		{
+			// every new write pushes the deadline back, so a burst yields one change
+			f.pending = true;
+			f.due = Clock::now() + debounce;
+		}
+	}
+}
+
+// Hands files whose debounce expired to the render loop, returns the
+// milliseconds until the next one is due or -1 when nothing is pending.
+int FileWatcher::flushDue()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto now = Clock::now();
+	int wait = -1;
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		auto& f = files[i];
+		if (!f.pending) { continue; }
+
+		// a full queue just keeps the file pending until the next pass
+		if (f.due <= now && changes.push((int)i))
+		{
+			f.pending = false;
+			continue;
+		}
+
+		int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(f.due - now).count();
+		ms = std::max(ms, 1);
+		wait = wait < 0 ? ms : std::min(wait, ms);
+	}
+
+	return wait;
+}
+
+#ifdef __linux__
+
+void FileWatcher::threadLoop()
+{
+	alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+
+	while (running)
+	{
+		int timeout = flushDue();
+
+		pollfd fds[2] = {};
+		fds[0].fd = notifyFd;
+		fds[0].events = POLLIN;
+		fds[1].fd = wakeFd;
+		fds[1].events = POLLIN;
+
+		if (::poll(fds, 2, timeout) <= 0) { continue; }
+		if (!running) { break; }
+
+		if (!(fds[0].revents & POLLIN)) { continue; }
+
+		ssize_t length;
+		while ((length = read(notifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* p = buffer; p < buffer + length; )
+			{
+				auto event = (const inotify_event*)p;
+				p += sizeof(inotify_event) + event->len;
+
+				if (!event->len) { continue; }
+
+				std::string directory;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					for (auto& w : directoryWatches)
+					{
+						if (w.first == event->wd) { directory = w.second; break; }
+					}
+				}
+
+				if (!directory.empty()) { markChanged(directory, event->name); }
+			}
+		}
+	}
+}
+
+#else
+
+void FileWatcher::threadLoop()
+{
+	while (running)
+	{
+		std::vector<std::pair<std::string, std::string>> changed;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& f : files)
+			{
+				long long lastWrite = getLastWrite(f.path);
+				if (lastWrite && lastWrite != f.lastWrite)
+				{
+					f.lastWrite = lastWrite;
+					changed.push_back({ f.directory, f.name });
+				}
+			}
+		}
+
+		for (auto& c : changed) { markChanged(c.first, c.second); }
+
+		int wait = flushDue();
+		auto sleep = wait < 0 ? statInterval : std::min(statInterval, std::chrono::milliseconds(wait));
+		std::this_thread::sleep_for(sleep);
+	}
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <frameCache.h>
+#include <algorithm>
+#include <iostream>
+
+void FrameCache::clear()
+{
+	if (fbo) { glDeleteFramebuffers(1, &fbo); }
+	if (texture) { glDeleteTextures(1, &texture); }
+	fbo = texture = 0;
+	width = height = 0;
+	valid = false;
+}
+
+bool FrameCache::isNeverStatic(RenderGraph& graph)
+{
+	// these change every frame, a shader reading them is never static
+	return graph.hasFeedback() || graph.uses(UniformFrame) || graph.uses(UniformTimeDelta) || graph.uses(UniformFrameRate);
+}
+
+bool FrameCache::readsSameInputs(const RenderGraph& graph, const BuiltinUniformValues& inputs) const
+{
+	if (graph.uses(UniformTime) && inputs.time != this->inputs.time) { return false; }
+	if (graph.uses(UniformMouse) && !std::equal(inputs.mouse, inputs.mouse + 4, this->inputs.mouse)) { return false; }
+	if (graph.uses(UniformDate) && !std::equal(inputs.date, inputs.date + 4, this->inputs.date)) { return false; }
+	return inputs.sampleCount == this->inputs.sampleCount;
+}
+
+bool FrameCache::isCurrent(RenderGraph& graph, const BuiltinUniformValues& inputs, int width, int height, int imageWidth, int imageHeight) const
+{
+	if (!enabled || !valid) { return false; }
+	if (width != this->width || height != this->height) { return false; }
+	if (imageWidth != this->imageWidth || imageHeight != this->imageHeight) { return false; }
+	if (graph.getVersion() != graphVersion || isNeverStatic(graph)) { return false; }
+
+	return readsSameInputs(graph, inputs);
+}
+
+void FrameCache::store(RenderGraph& graph, const BuiltinUniformValues& inputs, GLuint framebuffer, int width, int height, int imageWidth, int imageHeight)
+{
+	// While the inputs keep changing (time running, the mouse dragging) the next
+	// frame won't match either, so the copy is only made once a frame repeats
+	// the inputs of the one before it. That costs one more draw after pausing.
+	bool repeated = readsSameInputs(graph, inputs);
+	this->inputs = inputs;
+
+	if (!enabled || width <= 0 || height <= 0 || isNeverStatic(graph) || !repeated)
+	{
+		valid = false;
+		return;
+	}
+
+	if (width != this->width || height != this->height)
+	{
+		if (fbo) { glDeleteFramebuffers(1, &fbo); }
+		if (texture) { glDeleteTextures(1, &texture); }
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Frame cache framebuffer is incomplete\n";
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		this->width = width;
+		this->height = height;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	this->imageWidth = imageWidth;
+	this->imageHeight = imageHeight;
+	graphVersion = graph.getVersion();
+	valid = true;
+}
+
+void FrameCache::present(GLuint framebuffer)
+{
+	if (!fbo) { return; }
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	reusedFrames++;
+}
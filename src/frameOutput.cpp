@@ -0,0 +1,53 @@
+#include <frameOutput.h>
+
+bool writePPM(const std::string& path, int width, int height, const unsigned char* rgba, size_t stride)
+{
+	PPMStripWriter writer;
+	if (!writer.open(path, width, height)) { return false; }
+
+	writer.writeStrip(rgba, stride, height);
+	return writer.close();
+}
+
+bool PPMStripWriter::open(const std::string& path, int width, int height)
+{
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) { return false; }
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	this->width = width;
+	rowsLeft = height;
+	row.resize((size_t)width * 3);
+	return file.good();
+}
+
+bool PPMStripWriter::writeStrip(const unsigned char* rgba, size_t stride, int rows)
+{
+	if (rows > rowsLeft) { return false; }
+
+	// PPM rows go top down
+	for (int y = rows - 1; y >= 0; y--)
+	{
+		const unsigned char* src = rgba + (size_t)y * stride;
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+
+	rowsLeft -= rows;
+	return file.good();
+}
+
+bool PPMStripWriter::close()
+{
+	if (!file.is_open()) { return false; }
+
+	bool ok = file.good() && rowsLeft == 0;
+	file.close();
+	return ok && !file.fail();
+}
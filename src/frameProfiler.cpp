@@ -0,0 +1,172 @@
+#include <frameProfiler.h>
+#include "imgui.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// sorting 600 samples per stage every frame would show up in the profile itself
+static const int percentileInterval = 15;
+
+int FrameProfiler::addStage(const char* name)
+{
+	stages.emplace_back();
+	stages.back().name = name;
+	return (int)stages.size() - 1;
+}
+
+void FrameProfiler::beginFrame()
+{
+	frame.name = "Frame";
+	frame.start = std::chrono::steady_clock::now();
+	frame.frameMs = 0;
+	for (auto& s : stages) { s.frameMs = 0; }
+}
+
+void FrameProfiler::endFrame()
+{
+	frame.frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.start).count();
+
+	frame.lastMs = (float)frame.frameMs;
+	frame.history[next] = frame.lastMs;
+	for (auto& s : stages)
+	{
+		s.lastMs = (float)s.frameMs;
+		s.history[next] = s.lastMs;
+	}
+
+	next = (next + 1) % historySize;
+	recorded = std::min(recorded + 1, historySize);
+
+	if (++framesSincePercentiles >= percentileInterval)
+	{
+		framesSincePercentiles = 0;
+		updatePercentiles();
+	}
+}
+
+float FrameProfiler::getSample(const Stage& s, int age) const
+{
+	// age 0 is the oldest recorded frame
+	int index = (next - recorded + age + historySize) % historySize;
+	return s.history[index];
+}
+
+void FrameProfiler::updatePercentiles()
+{
+	if (recorded == 0) { return; }
+
+	std::vector<float> sorted(recorded);
+
+	auto update = [&](Stage& s)
+	{
+		for (int i = 0; i < recorded; i++) { sorted[i] = getSample(s, i); }
+		std::sort(sorted.begin(), sorted.end());
+
+		auto at = [&](float p) { return sorted[std::min(recorded - 1, (int)(p * recorded))]; };
+		s.p50 = at(0.50f);
+		s.p95 = at(0.95f);
+		s.p99 = at(0.99f);
+		s.max = sorted.back();
+	};
+
+	update(frame);
+	for (auto& s : stages) { update(s); }
+}
+
+bool FrameProfiler::exportCSV(const std::string& path) const
+{
+	std::ofstream f(path);
+	if (!f.is_open()) { return false; }
+
+	f << "frame,total_ms";
+	for (auto& s : stages) { f << "," << s.name << "_ms"; }
+	f << "\n";
+
+	for (int i = 0; i < recorded; i++)
+	{
+		f << i << "," << getSample(frame, i);
+		for (auto& s : stages) { f << "," << getSample(s, i); }
+		f << "\n";
+	}
+
+	return f.good();
+}
+
+bool FrameProfiler::exportJSON(const std::string& path) const
+{
+	std::ofstream f(path);
+	if (!f.is_open()) { return false; }
+
+	auto writeStage = [&](const Stage& s)
+	{
+		f << "    { \"name\": \"" << s.name << "\", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+			<< ", \"p99\": " << s.p99 << ", \"max\": " << s.max << ", \"samples\": [";
+		for (int i = 0; i < recorded; i++) { f << (i ? ", " : "") << getSample(s, i); }
+		f << "] }";
+	};
+
+	f << "{\n  \"frames\": " << recorded << ",\n  \"stages\": [\n";
+	writeStage(frame);
+	for (auto& s : stages)
+	{
+		f << ",\n";
+		writeStage(s);
+	}
+	f << "\n  ]\n}\n";
+
+	return f.good();
+}
+
+void FrameProfiler::drawOverlay(bool* open)
+{
+	ImGui::SetNextWindowSize(ImVec2(460, 0), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Frame Profiler", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("CPU ms over the last %d frames", recorded);
+
+	if (ImGui::BeginTable("stages", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+	{
+		const char* columns[] = { "Stage", "last", "p50", "p95", "p99", "max" };
+		for (auto c : columns) { ImGui::TableSetupColumn(c); }
+		ImGui::TableHeadersRow();
+
+		auto row = [](const Stage& s)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(s.name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", s.lastMs);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", s.p50);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", s.p95);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", s.p99);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", s.max);
+		};
+
+		row(frame);
+		for (auto& s : stages) { row(s); }
+
+		ImGui::EndTable();
+	}
+
+	// frame times oldest to newest, spikes stand out here
+	std::vector<float> times(recorded);
+	for (int i = 0; i < recorded; i++) { times[i] = getSample(frame, i); }
+	ImGui::PlotLines("##frames", times.data(), recorded, 0, "frame ms", 0.0f, std::max(frame.max, 1.0f), ImVec2(-1, 80));
+
+	if (ImGui::Button("Export CSV"))
+	{
+		std::string path = "profile_" + std::to_string(exportCount++) + ".csv";
+		std::cout << (exportCSV(path) ? "Saved " : "Error writing ") << path << "\n";
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON"))
+	{
+		std::string path = "profile_" + std::to_string(exportCount++) + ".json";
+		std::cout << (exportJSON(path) ? "Saved " : "Error writing ") << path << "\n";
+	}
+
+	ImGui::End();
+}
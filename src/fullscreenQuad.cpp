@@ -0,0 +1,55 @@
+#include <fullscreenQuad.h>
+
+static const float quadVertices[] = {
+		1.0, 1.0, 0,	1, 0, 0,	// Vertex 1
+	   -1.0, 1.0, 0,	0, 1, 0,	// Vertex 2
+	   -1.0, -1.0, 0,	0, 0, 1,	// Vertex 3
+		1.0, -1.0, 0,	0, 0, 1		// Vertex 4
+};
+
+static const unsigned short quadIndices[] = {
+	0, 1, 2,
+	0, 2, 3
+};
+
+void FullscreenQuad::create()
+{
+	// Vertex Array Object
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// Vertex Buffer Object
+	glGenBuffers(1, &vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+
+	// Index Buffer Object
+	glGenBuffers(1, &ibo);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+
+	// Unbind VAO
+	glBindVertexArray(0);
+}
+
+void FullscreenQuad::draw()
+{
+	glBindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+}
+
+void FullscreenQuad::clear()
+{
+	glDeleteBuffers(1, &ibo);
+	glDeleteBuffers(1, &vbo);
+	glDeleteVertexArrays(1, &vao);
+	vao = vbo = ibo = 0;
+}
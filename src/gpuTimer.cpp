@@ -0,0 +1,160 @@
+#include <gpuTimer.h>
+#include <algorithm>
+
+bool GpuTimer::init(int frameLatency)
+{
+	clear();
+	frames.resize(frameLatency);
+	frame.name = "Frame";
+	return true;
+}
+
+void GpuTimer::clear()
+{
+	for (auto& f : frames)
+	{
+		if (!f.pool.empty()) { glDeleteQueries((GLsizei)f.pool.size(), f.pool.data()); }
+	}
+	frames.clear();
+	passes.clear();
+	open.clear();
+	frame = Pass();
+	current = 0;
+	frameNumber = 0;
+	inFrame = false;
+}
+
+GLuint GpuTimer::nextQuery()
+{
+	FrameQueries& f = frames[current];
+	if (f.used == (int)f.pool.size())
+	{
+		GLuint id = 0;
+		glGenQueries(1, &id);
+		f.pool.push_back(id);
+	}
+	return f.pool[f.used++];
+}
+
+void GpuTimer::addSample(Pass& p, double ms, long long frameNumber)
+{
+	p.lastMs = ms;
+	p.lastFrame = frameNumber;
+	p.samples[p.next] = (float)ms;
+	p.next = (p.next + 1) % Pass::sampleCount;
+	if (p.sampled < Pass::sampleCount) { p.sampled++; }
+
+	double sum = 0;
+	for (int i = 0; i < p.sampled; i++) { sum += p.samples[i]; }
+	p.averageMs = sum / p.sampled;
+}
+
+void GpuTimer::resolve(FrameQueries& f)
+{
+	if (!f.pending) { return; }
+	f.pending = false;
+
+	// queries finish in order, if the last one is in they all are
+	GLint available = 0;
+	glGetQueryObjectiv(f.pool[f.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) { return; }
+
+	// a pass begun several times in a frame (one per tile) is one sample, the sum
+	std::vector<double> totals(passes.size() + 1, -1.0);
+	for (auto& interval : f.intervals)
+	{
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(interval.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(interval.end, GL_QUERY_RESULT, &end);
+
+		double& total = totals[interval.pass + 1];
+		total = std::max(total, 0.0) + (end - begin) / 1000000.0;
+	}
+
+	for (size_t i = 0; i < totals.size(); i++)
+	{
+		if (totals[i] < 0) { continue; }
+		addSample(i == 0 ? frame : passes[i - 1], totals[i], f.number);
+	}
+}
+
+void GpuTimer::beginFrame()
+{
+	if (frames.empty() || inFrame) { return; }
+
+	current = (current + 1) % (int)frames.size();
+
+	// this slot was last used frameLatency frames ago
+	FrameQueries& f = frames[current];
+	resolve(f);
+	f.used = 0;
+	f.intervals.clear();
+	f.number = ++frameNumber;
+	open.clear();
+
+	inFrame = true;
+	beginPass(nullptr);
+}
+
+void GpuTimer::endFrame()
+{
+	if (!inFrame) { return; }
+
+	while (!open.empty()) { endPass(); }
+
+	frames[current].pending = frames[current].used > 0;
+	inFrame = false;
+}
+
+void GpuTimer::beginPass(const char* name)
+{
+	if (!inFrame) { return; }
+
+	int pass = -1;
+	if (name)
+	{
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			if (passes[i].name == name) { pass = (int)i; break; }
+		}
+		if (pass < 0)
+		{
+			passes.emplace_back();
+			passes.back().name = name;
+			pass = (int)passes.size() - 1;
+		}
+	}
+
+	GLuint query = nextQuery();
+	glQueryCounter(query, GL_TIMESTAMP);
+
+	FrameQueries& f = frames[current];
+	f.intervals.push_back({ pass, query, 0 });
+	open.push_back(f.intervals.size() - 1);
+}
+
+void GpuTimer::endPass()
+{
+	if (!inFrame || open.empty()) { return; }
+
+	GLuint query = nextQuery();
+	glQueryCounter(query, GL_TIMESTAMP);
+
+	frames[current].intervals[open.back()].end = query;
+	open.pop_back();
+}
+
+double GpuTimer::getPassMs(const char* name) const
+{
+	const Pass* p = findPass(name);
+	return p ? p->averageMs : 0;
+}
+
+const GpuTimer::Pass* GpuTimer::findPass(const char* name) const
+{
+	for (auto& p : passes)
+	{
+		if (p.name == name) { return &p; }
+	}
+	return nullptr;
+}
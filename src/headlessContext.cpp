@@ -0,0 +1,195 @@
+#include <headlessContext.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <cstring>
+
+#ifdef SHADERTOY_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+bool HeadlessContext::create()
+{
+	if (createEGL() || createOSMesa())
+	{
+		std::cout << "Headless context: " << backend << ", " << (const char*)glGetString(GL_RENDERER)
+			<< ", GL " << (const char*)glGetString(GL_VERSION) << "\n";
+		return true;
+	}
+
+	std::cout << "Failed to create a headless OpenGL context\n";
+	return false;
+}
+
+void HeadlessContext::destroy()
+{
+#ifdef SHADERTOY_HAS_EGL
+	if (eglContext)
+	{
+		eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)eglDisplay, (EGLContext)eglContext);
+		eglTerminate((EGLDisplay)eglDisplay);
+		eglContext = nullptr;
+		eglDisplay = nullptr;
+	}
+#endif
+
+	if (window)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = nullptr;
+	}
+
+	backend = "none";
+}
+
+#ifdef SHADERTOY_HAS_EGL
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+	if (!extensions) { return false; }
+
+	size_t length = strlen(name);
+	for (const char* p = strstr(extensions, name); p; p = strstr(p + length, name))
+	{
+		bool start = p == extensions || p[-1] == ' ';
+		bool end = p[length] == ' ' || p[length] == '\0';
+		if (start && end) { return true; }
+	}
+	return false;
+}
+
+static EGLDisplay openDisplay(const char*& backend)
+{
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (!getPlatformDisplay) { return EGL_NO_DISPLAY; }
+
+	// Mesa, including llvmpipe on machines without a GPU
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		EGLint major, minor;
+		if (display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+		{
+			backend = "EGL surfaceless";
+			return display;
+		}
+	}
+
+	// NVIDIA's headless path
+	if (hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+	{
+		auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+		EGLDeviceEXT device;
+		EGLint count = 0;
+		if (queryDevices && queryDevices(1, &device, &count) && count > 0)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+			EGLint major, minor;
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+			{
+				backend = "EGL device";
+				return display;
+			}
+		}
+	}
+
+	return EGL_NO_DISPLAY;
+}
+
+bool HeadlessContext::createEGL()
+{
+	const char* name = "none";
+	EGLDisplay display = openDisplay(name);
+	if (display == EGL_NO_DISPLAY) { return false; }
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		eglTerminate(display);
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE };
+
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+	if (configCount == 0) { config = EGL_NO_CONFIG_KHR; }
+
+	// the shaders say #version 450, 4.3 is a last resort for drivers that report less
+	const EGLint versions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 3 } };
+
+	EGLContext context = EGL_NO_CONTEXT;
+	for (auto& v : versions)
+	{
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, v[0],
+			EGL_CONTEXT_MINOR_VERSION, v[1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE };
+
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context != EGL_NO_CONTEXT) { break; }
+	}
+
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ||
+		!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+	{
+		if (context != EGL_NO_CONTEXT) { eglDestroyContext(display, context); }
+		eglTerminate(display);
+		return false;
+	}
+
+	eglDisplay = display;
+	eglContext = context;
+	backend = name;
+	return true;
+}
+
+#else
+
+bool HeadlessContext::createEGL()
+{
+	return false;
+}
+
+#endif
+
+bool HeadlessContext::createOSMesa()
+{
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	if (!glfwInit()) { return false; }
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	// the null platform's window is only a holder for the context
+	window = glfwCreateWindow(1, 1, "ShaderToy", nullptr, nullptr);
+	if (!window)
+	{
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = nullptr;
+		return false;
+	}
+
+	backend = "GLFW null platform + OSMesa";
+	return true;
+}
@@ -0,0 +1,284 @@
+#include <imageDecoder.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <new>
+
+#ifdef SHADERTOY_HAS_PNG
+#include <png.h>
+#endif
+
+#ifdef SHADERTOY_HAS_JPEG
+#include <jpeglib.h>
+#endif
+
+// the header's size, checked before the pixels are allocated
+static bool checkSize(long long width, long long height, int maxSize, std::string& error)
+{
+	if (width <= maxSize && height <= maxSize) { return true; }
+
+	error = std::to_string(width) + " x " + std::to_string(height) + " is larger than the GPU allows";
+	return false;
+}
+
+#ifdef SHADERTOY_HAS_PNG
+static bool decodePNG(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error)
+{
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_memory(&image, data, size))
+	{
+		error = image.message;
+		return false;
+	}
+
+	if (!checkSize(image.width, image.height, maxSize, error))
+	{
+		png_image_free(&image);
+		return false;
+	}
+
+	// palettes, grey and 16 bit channels all come out as 8 bit RGBA
+	image.format = PNG_FORMAT_RGBA;
+	out.width = (int)image.width;
+	out.height = (int)image.height;
+	out.hdr = false;
+	out.pixels.resize(PNG_IMAGE_SIZE(image));
+
+	if (!png_image_finish_read(&image, nullptr, out.pixels.data(), 0, nullptr))
+	{
+		error = image.message;
+		png_image_free(&image);
+		return false;
+	}
+	return true;
+}
+#endif
+
+#ifdef SHADERTOY_HAS_JPEG
+struct JpegError
+{
+	jpeg_error_mgr manager;
+	jmp_buf jump;
+	char message[JMSG_LENGTH_MAX];
+};
+
+static void onJpegError(j_common_ptr info)
+{
+	JpegError* e = (JpegError*)info->err;
+	(*info->err->format_message)(info, e->message);
+	longjmp(e->jump, 1);
+}
+
+static bool decodeJPEG(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error)
+{
+	jpeg_decompress_struct info;
+	JpegError e;
+	info.err = jpeg_std_error(&e.manager);
+	e.manager.error_exit = onJpegError;
+
+	if (setjmp(e.jump))
+	{
+		jpeg_destroy_decompress(&info);
+		error = e.message;
+		return false;
+	}
+
+	jpeg_create_decompress(&info);
+	jpeg_mem_src(&info, (unsigned char*)data, (unsigned long)size);
+	jpeg_read_header(&info, TRUE);
+
+	if (!checkSize(info.image_width, info.image_height, maxSize, error))
+	{
+		jpeg_destroy_decompress(&info);
+		return false;
+	}
+
+	info.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&info);
+
+	out.width = (int)info.output_width;
+	out.height = (int)info.output_height;
+	out.hdr = false;
+	out.pixels.resize((size_t)out.width * out.height * 4);
+
+	// from libjpeg's pool, freed with the decompressor whichever way it ends;
+	// a vector set up after setjmp would be indeterminate after the longjmp
+	JSAMPARRAY rows = (*info.mem->alloc_sarray)((j_common_ptr)&info, JPOOL_IMAGE, info.output_width * 3, 1);
+	const unsigned char* row = rows[0];
+
+	while (info.output_scanline < info.output_height)
+	{
+		unsigned char* dst = out.pixels.data() + (size_t)info.output_scanline * out.width * 4;
+		jpeg_read_scanlines(&info, rows, 1);
+
+		for (int x = 0; x < out.width; x++)
+		{
+			dst[x * 4 + 0] = row[x * 3 + 0];
+			dst[x * 4 + 1] = row[x * 3 + 1];
+			dst[x * 4 + 2] = row[x * 3 + 2];
+			dst[x * 4 + 3] = 255;
+		}
+	}
+
+	jpeg_finish_decompress(&info);
+	jpeg_destroy_decompress(&info);
+	return true;
+}
+#endif
+
+// Radiance RGBE, the format HDR environment maps usually come in. Only the
+// common -Y H +X W orientation and the run length encoding every writer uses.
+static bool decodeHDR(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error)
+{
+	size_t at = 0;
+	auto readLine = [&](std::string& line)
+	{
+		line.clear();
+		while (at < size && data[at] != '\n') { line += (char)data[at++]; }
+		if (at >= size) { return false; }
+		at++;
+		return true;
+	};
+
+	std::string line;
+	bool rgbe = false;
+	while (readLine(line) && !line.empty())
+	{
+		if (line == "FORMAT=32-bit_rle_rgbe") { rgbe = true; }
+	}
+	if (!rgbe)
+	{
+		error = "not an RGBE image";
+		return false;
+	}
+
+	int width = 0, height = 0;
+	if (!readLine(line) || sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+	{
+		error = "unsupported HDR orientation \"" + line + "\"";
+		return false;
+	}
+
+	if (!checkSize(width, height, maxSize, error)) { return false; }
+
+	out.width = width;
+	out.height = height;
+	out.hdr = true;
+	out.pixels.resize((size_t)width * height * 16);
+
+	std::vector<unsigned char> scanline((size_t)width * 4);
+	for (int y = 0; y < height; y++)
+	{
+		bool encoded = width >= 8 && width < 0x8000 && at + 4 <= size &&
+			data[at] == 2 && data[at + 1] == 2 && ((data[at + 2] << 8) | data[at + 3]) == width;
+
+		if (encoded)
+		{
+			// each of the four components in turn, as runs and literal spans
+			at += 4;
+			for (int c = 0; c < 4; c++)
+			{
+				int x = 0;
+				while (x < width)
+				{
+					if (at >= size) { error = "truncated HDR data"; return false; }
+					int count = data[at++];
+					bool run = count > 128;
+					if (run) { count -= 128; }
+					if (count == 0 || x + count > width || at + (run ? 1 : count) > size)
+					{
+						error = "corrupt HDR scanline";
+						return false;
+					}
+					for (int i = 0; i < count; i++) { scanline[(x + i) * 4 + c] = data[run ? at : at + i]; }
+					at += run ? 1 : count;
+					x += count;
+				}
+			}
+		}
+		else
+		{
+			if (at + scanline.size() > size) { error = "truncated HDR data"; return false; }
+			std::copy(data + at, data + at + scanline.size(), scanline.begin());
+			at += scanline.size();
+		}
+
+		float* dst = (float*)out.pixels.data() + (size_t)y * width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* p = &scanline[x * 4];
+			float f = p[3] ? std::ldexp(1.0f, p[3] - 136) : 0.0f;
+			dst[x * 4 + 0] = p[0] * f;
+			dst[x * 4 + 1] = p[1] * f;
+			dst[x * 4 + 2] = p[2] * f;
+			dst[x * 4 + 3] = 1.0f;
+		}
+	}
+
+	return true;
+}
+
+static bool decodeAny(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error)
+{
+	if (size >= 8 && memcmp(data, "\x89PNG", 4) == 0)
+	{
+#ifdef SHADERTOY_HAS_PNG
+		return decodePNG(data, size, maxSize, out, error);
+#else
+		error = "built without PNG support";
+		return false;
+#endif
+	}
+
+	if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+	{
+#ifdef SHADERTOY_HAS_JPEG
+		return decodeJPEG(data, size, maxSize, out, error);
+#else
+		error = "built without JPEG support";
+		return false;
+#endif
+	}
+
+	if (size >= 2 && data[0] == '#' && data[1] == '?')
+	{
+		return decodeHDR(data, size, maxSize, out, error);
+	}
+
+	error = "unknown image format";
+	return false;
+}
+
+bool decodeImage(const unsigned char* data, size_t size, int maxSize, DecodedImage& out, std::string& error)
+{
+	out = DecodedImage();
+
+	// runs on the decode threads, where an uncaught bad_alloc would end the app
+	try
+	{
+		if (decodeAny(data, size, maxSize, out, error)) { return true; }
+	}
+	catch (const std::bad_alloc&)
+	{
+		error = "out of memory";
+	}
+
+	out = DecodedImage();
+	return false;
+}
+
+bool isImageFileName(const std::string& name)
+{
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos) { return false; }
+
+	std::string extension = name.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "hdr";
+}
@@ -0,0 +1,109 @@
+#include <mappedFile.h>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this == &other) { return *this; }
+
+	close();
+	std::swap(data, other.data);
+	std::swap(size, other.size);
+#ifdef _WIN32
+	std::swap(file, other.file);
+	std::swap(mapping, other.mapping);
+#endif
+	return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE) { return false; }
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(f, &length) || length.QuadPart == 0)
+	{
+		CloseHandle(f);
+		return false;
+	}
+
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view)
+	{
+		if (m) { CloseHandle(m); }
+		CloseHandle(f);
+		return false;
+	}
+
+	file = f;
+	mapping = m;
+	data = (const unsigned char*)view;
+	size = (size_t)length.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) { return false; }
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// the mapping keeps the file alive on its own
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) { return false; }
+
+	data = (const unsigned char*)view;
+	size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!data) { return; }
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+	file = mapping = nullptr;
+#else
+	munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+	if (!data || offset >= size) { return; }
+	length = length < size - offset ? length : size - offset;
+
+#ifdef _WIN32
+	// PrefetchVirtualMemory needs Windows 8, first touch still works without it
+	(void)length;
+#else
+	// madvise wants a page aligned start
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset / page * page;
+	madvise((void*)(data + start), length + (offset - start), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,484 @@
+#include <offlineRender.h>
+#include <headlessContext.h>
+#include <shaderLoader.h>
+#include <programCache.h>
+#include <fullscreenQuad.h>
+#include <renderGraph.h>
+#include <readbackRing.h>
+#include <frameOutput.h>
+#include <videoWriter.h>
+#include <gpuTimer.h>
+#include <textureLoader.h>
+#include <channelTextures.h>
+#include <glad/glad.h>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+static const char* usage =
+	"Usage: ShaderToy --render shader.frag [--frames 0-600] [--size 3840x2160] [--fps 60] [--tile 2048]\n"
+	"                 [--output frame_%05d.ppm | --video out.y4m | --video \"|ffmpeg -i - out.mp4\"] [--raw]\n";
+
+bool isOfflineRenderRequested(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--render") == 0) { return true; }
+	}
+	return false;
+}
+
+// The pattern goes to snprintf with the frame number, so it must hold exactly one
+// %d, optionally zero padded to a width, and no other conversion but %%.
+static bool isFramePattern(const std::string& pattern)
+{
+	int conversions = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		if (pattern[i] != '%') { continue; }
+
+		i++;
+		if (i < pattern.size() && pattern[i] == '%') { continue; }
+
+		while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9') { i++; }
+		if (i == pattern.size() || pattern[i] != 'd') { return false; }
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+bool parseOfflineRenderArgs(int argc, char** argv, OfflineRenderOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (arg == "--raw")
+		{
+			options.raw = true;
+			continue;
+		}
+
+		if (!value)
+		{
+			std::cout << "Missing value for " << arg << "\n" << usage;
+			return false;
+		}
+
+		bool ok = true;
+		if (arg == "--render")
+		{
+			options.shaderPath = value;
+		}
+		else if (arg == "--frames")
+		{
+			// "first-last" or just a frame count
+			int first = 0, last = 0;
+			if (sscanf(value, "%d-%d", &first, &last) == 2) { options.firstFrame = first; options.lastFrame = last; }
+			else if (sscanf(value, "%d", &last) == 1) { options.firstFrame = 0; options.lastFrame = last - 1; }
+			else { ok = false; }
+			ok = ok && options.firstFrame >= 0 && options.lastFrame >= options.firstFrame;
+		}
+		else if (arg == "--size")
+		{
+			ok = sscanf(value, "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+		}
+		else if (arg == "--fps")
+		{
+			ok = sscanf(value, "%lf", &options.fps) == 1 && options.fps > 0;
+		}
+		else if (arg == "--tile")
+		{
+			ok = sscanf(value, "%d", &options.tileSize) == 1 && options.tileSize > 0;
+		}
+		else if (arg == "--output")
+		{
+			options.output = value;
+			ok = isFramePattern(options.output);
+		}
+		else if (arg == "--video")
+		{
+			options.video = value;
+		}
+		else
+		{
+			std::cout << "Unknown option " << arg << "\n" << usage;
+			return false;
+		}
+
+		if (!ok)
+		{
+			std::cout << "Bad value for " << arg << ": " << value << "\n" << usage;
+			return false;
+		}
+
+		i++;
+	}
+
+	if (options.shaderPath.empty())
+	{
+		std::cout << usage;
+		return false;
+	}
+
+	return true;
+}
+
+static std::string getFramePath(const std::string& pattern, int frame)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), pattern.c_str(), frame);
+	return path;
+}
+
+// Renders the image pass a tile at a time, strips of tiles top down, and streams
+// each strip to the file once its tiles are read back. Only a strip is ever held
+// in memory, and every tile is a submission of its own.
+// What the editor shows of a saved file, or all of a file without the markers
+static std::string getUserCode(const std::string& source)
+{
+	size_t begin = source.find("// BEGIN_USER_CODE");
+	size_t end = begin != std::string::npos ? source.find("// END_USER_CODE", begin) : std::string::npos;
+	if (end == std::string::npos) { return source; }
+	return source.substr(begin, end - begin);
+}
+
+static bool writeTiledFrame(RenderGraph& graph, const BuiltinUniformValues& inputs, const OfflineRenderOptions& options,
+	GLuint tileFramebuffer, int tileSize, std::vector<unsigned char>& strip, const std::string& path, GpuTimer& gpuTimer)
+{
+	PPMStripWriter writer;
+	if (!writer.open(path, options.width, options.height)) { return false; }
+
+	// tiles land side by side in the strip
+	glPixelStorei(GL_PACK_ROW_LENGTH, options.width);
+
+	ImageTarget tile;
+	tile.framebuffer = tileFramebuffer;
+	tile.width = options.width;
+	tile.height = options.height;
+
+	bool ok = true;
+	for (int top = options.height; top > 0 && ok; top -= tileSize)
+	{
+		tile.tileY = std::max(0, top - tileSize);
+		tile.tileHeight = top - tile.tileY;
+
+		for (tile.tileX = 0; tile.tileX < options.width; tile.tileX += tileSize)
+		{
+			tile.tileWidth = std::min(tileSize, options.width - tile.tileX);
+			graph.renderImage(inputs, tile, &gpuTimer);
+			glReadPixels(0, 0, tile.tileWidth, tile.tileHeight, GL_RGBA, GL_UNSIGNED_BYTE, strip.data() + (size_t)tile.tileX * 4);
+		}
+
+		ok = writer.writeStrip(strip.data(), (size_t)options.width * 4, tile.tileHeight);
+	}
+
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	return writer.close() && ok;
+}
+
+int runOfflineRender(const OfflineRenderOptions& options)
+{
+	HeadlessContext context;
+	if (!context.create()) { return 1; }
+
+	GLint maxSize = 0, maxViewport[2] = {};
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+	maxSize = std::min(maxSize, (GLint)std::min(maxViewport[0], maxViewport[1]));
+
+	// frames over the driver limit can still be rendered in tiles
+	int tileSize = options.tileSize;
+	bool oversized = options.width > maxSize || options.height > maxSize;
+	if (oversized && tileSize == 0) { tileSize = std::min(maxSize, 2048); }
+	tileSize = std::min(tileSize, (int)maxSize);
+	bool tiled = tileSize > 0;
+
+	if (tiled && !options.video.empty())
+	{
+		std::cout << "Tiled renders write PPM frames only, leave out --video\n";
+		context.destroy();
+		return 1;
+	}
+
+	ProgramCache programCache;
+	programCache.init(getDefaultProgramCacheDirectory());
+
+	std::string vertexSource;
+	if (!readShaderFile(RESOURCES_PATH "vertex.vert", vertexSource))
+	{
+		context.destroy();
+		return 1;
+	}
+
+	FullscreenQuad quad;
+	quad.create();
+
+	RenderGraph graph;
+	graph.init(&quad);
+
+	// the shader is the image pass, buffer files next to it are picked up the same
+	// way the editor does
+	auto shaderDirectory = std::filesystem::path(options.shaderPath).parent_path();
+	std::string imageSource;
+	for (int i = 0; i < RenderPassCount; i++)
+	{
+		std::string path = i == PassImage ? options.shaderPath : (shaderDirectory / getRenderPassFileName(i)).string();
+		if (i != PassImage && !std::filesystem::exists(path)) { continue; }
+
+		std::string fragmentSource;
+		Shader s;
+		ShaderDiagnostics diagnostics;
+		if (!readShaderFile(path.c_str(), fragmentSource) ||
+			!s.build({ { GL_VERTEX_SHADER, vertexSource, RESOURCES_PATH "vertex.vert" },
+			{ GL_FRAGMENT_SHADER, fragmentSource, path } }, &diagnostics, &programCache))
+		{
+			std::cout << diagnostics.getErrors();
+			graph.clear();
+			quad.clear();
+			context.destroy();
+			return 1;
+		}
+
+		graph.setEnabled(i, true);
+		graph.setChannelBindings(i, fragmentSource);
+		if (i == PassImage) { imageSource = fragmentSource; }
+		graph.setProgram(i, s.id, fragmentSource);
+
+		if (i != PassImage) { std::cout << "Using " << getRenderPassName(i) << " from " << path << "\n"; }
+
+		if (i != PassImage && oversized)
+		{
+			// only the image pass is tiled, buffers are sampled anywhere so they stay whole
+			std::cout << getRenderPassName(i) << " can't be larger than " << maxSize << " pixels, render at a smaller size\n";
+			graph.clear();
+			quad.clear();
+			context.destroy();
+			return 1;
+		}
+	}
+
+	// every tile is drawn at 0,0, only a shader that adds iTileOffset to
+	// gl_FragCoord (as the prelude does) draws its own part of the image. The
+	// prelude's main() always does, so user code reading gl_FragCoord itself
+	// has to add it too
+	std::string userCode = getUserCode(imageSource);
+	bool offsetMissing = !graph.passUses(PassImage, UniformTileOffset) ||
+		(referencesIdentifier(userCode, "gl_FragCoord") && !referencesIdentifier(userCode, "iTileOffset"));
+	if (tiled && offsetMissing)
+	{
+		std::cout << "Tiled renders need the image pass to add iTileOffset to gl_FragCoord, " << options.shaderPath
+			<< " doesn't; add it or render at most " << maxSize << " pixels without --tile\n";
+		graph.clear();
+		quad.clear();
+		context.destroy();
+		return 1;
+	}
+
+	// channel images, all of them in before the first frame; audio is analysed
+	// for each frame's time as it is drawn
+	TextureLoader textureLoader;
+	textureLoader.init();
+	ChannelTextures channelTextures;
+	channelTextures.synchronousAudio = true;
+	float firstTime = (float)(options.firstFrame / options.fps);
+	channelTextures.update(graph, textureLoader, shaderDirectory.string(), firstTime);
+	textureLoader.finish();
+	channelTextures.update(graph, textureLoader, shaderDirectory.string(), firstTime);
+
+	if (tiled)
+	{
+		std::cout << "Rendering in " << (options.width + tileSize - 1) / tileSize << "x"
+			<< (options.height + tileSize - 1) / tileSize << " tiles of " << tileSize << " pixels\n";
+	}
+
+	// a single tile's worth when tiled, the frame is assembled in system memory
+	GLuint colorTexture = 0;
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, tiled ? tileSize : options.width, tiled ? tileSize : options.height);
+
+	GLuint fbo = 0;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+	int exitCode = 0;
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Offline render framebuffer is incomplete\n";
+		exitCode = 1;
+	}
+
+	std::error_code error;
+	auto outputDirectory = std::filesystem::path(getFramePath(options.output, options.firstFrame)).parent_path();
+	if (options.video.empty() && !outputDirectory.empty()) { std::filesystem::create_directories(outputDirectory, error); }
+
+	VideoWriter video;
+	if (!options.video.empty() && exitCode == 0)
+	{
+		VideoWriterOptions videoOptions;
+		videoOptions.output = options.video;
+		videoOptions.raw = options.raw;
+		videoOptions.width = options.width;
+		videoOptions.height = options.height;
+
+		// Y4M wants a fraction, 29.97 becomes 29970:1000
+		if (options.fps == (int)options.fps)
+		{
+			videoOptions.fpsNumerator = (int)options.fps;
+			videoOptions.fpsDenominator = 1;
+		}
+		else
+		{
+			videoOptions.fpsNumerator = (int)(options.fps * 1000 + 0.5);
+			videoOptions.fpsDenominator = 1000;
+		}
+
+		if (!video.open(videoOptions)) { exitCode = 1; }
+	}
+
+	// frames come back a few frames late so the GPU never waits for the disk
+	ReadbackRing readback;
+	std::vector<unsigned char> strip;
+	if (tiled)
+	{
+		strip.resize((size_t)options.width * tileSize * 4);
+	}
+	else
+	{
+		readback.init(options.width, options.height);
+	}
+
+	// the date is taken once so every frame of a run sees the same one
+	BuiltinUniformValues inputs;
+	inputs.resolution[0] = (float)options.width;
+	inputs.resolution[1] = (float)options.height;
+	inputs.resolution[2] = 1.0f;
+	inputs.timeDelta = (float)(1.0 / options.fps);
+	inputs.frameRate = (float)options.fps;
+	{
+		time_t now = time(0);
+		tm* ltm = localtime(&now);
+		inputs.date[0] = (float)(ltm->tm_year + 1900);
+		inputs.date[1] = (float)(ltm->tm_mon + 1);
+		inputs.date[2] = (float)ltm->tm_mday;
+		inputs.date[3] = (float)(ltm->tm_hour * 3600 + ltm->tm_min * 60 + ltm->tm_sec);
+	}
+
+	GpuTimer gpuTimer;
+	gpuTimer.init();
+
+	auto start = std::chrono::steady_clock::now();
+	int written = 0;
+
+	auto writeReadyFrames = [&](bool wait)
+	{
+		ReadbackFrame f;
+		while (exitCode == 0 && readback.acquire(f, wait))
+		{
+			if (video.isOpen())
+			{
+				// an offline render has no frames to spare, so it waits for the encoder
+				while (!video.submit(f, readback)) { video.waitForSpace(); }
+				written++;
+				if (wait) { break; }
+				continue;
+			}
+
+			std::string path = getFramePath(options.output, (int)f.tag);
+			if (writePPM(path, f.width, f.height, f.pixels, f.stride))
+			{
+				written++;
+			}
+			else
+			{
+				std::cout << "Error writing frame " << path << "\n";
+				exitCode = 1;
+			}
+			readback.release(f);
+
+			// one frame is enough to free a slot
+			if (wait) { break; }
+		}
+	};
+
+	for (int frame = options.firstFrame; frame <= options.lastFrame && exitCode == 0; frame++)
+	{
+		inputs.time = (float)(frame / options.fps);
+		inputs.frame = frame;
+		channelTextures.update(graph, textureLoader, shaderDirectory.string(), inputs.time);
+
+		gpuTimer.beginFrame();
+		gpuTimer.beginPass("Shader");
+		if (tiled)
+		{
+			graph.renderBuffers(inputs, options.width, options.height, &gpuTimer);
+
+			std::string path = getFramePath(options.output, frame);
+			if (writeTiledFrame(graph, inputs, options, fbo, tileSize, strip, path, gpuTimer))
+			{
+				written++;
+			}
+			else
+			{
+				std::cout << "Error writing frame " << path << "\n";
+				exitCode = 1;
+			}
+
+			gpuTimer.endPass();
+			gpuTimer.endFrame();
+			continue;
+		}
+
+		ImageTarget image;
+		image.framebuffer = fbo;
+		image.width = options.width;
+		image.height = options.height;
+		graph.render(inputs, options.width, options.height, image, &gpuTimer);
+		gpuTimer.endPass();
+		gpuTimer.endFrame();
+
+		while (exitCode == 0 && !readback.capture(frame))
+		{
+			// every slot may still be held by the video converters
+			if (!readback.hasPending() && video.isOpen()) { video.waitForRelease(readback.getSlotCount()); }
+			writeReadyFrames(true);
+		}
+		writeReadyFrames(false);
+	}
+
+	while (exitCode == 0 && readback.hasPending()) { writeReadyFrames(true); }
+
+	if (video.isOpen())
+	{
+		video.close();
+		if (video.hasFailed()) { exitCode = 1; }
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << written << " frames at " << options.width << "x" << options.height
+		<< " in " << seconds << " s (" << (seconds > 0 ? written / seconds : 0) << " frames/s)\n";
+	std::cout << "GPU shader time " << gpuTimer.getPassMs("Shader") << " ms per frame (average of the last "
+		<< GpuTimer::Pass::sampleCount << " frames)\n";
+
+	gpuTimer.clear();
+	readback.clear();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &colorTexture);
+	channelTextures.clear(textureLoader);
+	textureLoader.clear();
+	graph.clear();
+	quad.clear();
+	context.destroy();
+
+	return exitCode;
+}
@@ -0,0 +1,276 @@
+#include <programCache.h>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static const char cacheMagic[4] = { 'S', 'T', 'P', 'B' };
+static const uint32_t cacheVersion = 1;
+
+struct CacheEntryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t driverHash;
+	uint32_t format;
+	uint32_t length;
+};
+
+// FNV-1a
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	auto bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// 0 for a missing file
+static uint64_t getFileSize(const std::string& path)
+{
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(path, error);
+	return error ? 0 : size;
+}
+
+static std::string getGLString(GLenum name)
+{
+	auto s = (const char*)glGetString(name);
+	return s ? s : "";
+}
+
+bool ProgramCache::init(const std::string& directory, uint64_t maxBytes)
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats <= 0)
+	{
+		std::cout << "Program binaries are not supported by the driver, shader cache disabled\n";
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cout << "Error creating shader cache directory " << directory << ": " << error.message() << "\n";
+		return false;
+	}
+
+	this->directory = directory;
+	this->maxBytes = maxBytes;
+
+	driver = getGLString(GL_VENDOR) + "\n" + getGLString(GL_RENDERER) + "\n" + getGLString(GL_VERSION);
+	driverHash = hashBytes(driver.data(), driver.size());
+
+	// one walk to find where the cache stands, it may have grown past the limit
+	evict();
+
+	enabled = true;
+	return true;
+}
+
+uint64_t ProgramCache::getKey(const std::vector<ShaderStageSource>& stages) const
+{
+	uint64_t hash = driverHash;
+
+	for (auto& stage : stages)
+	{
+		hash = hashBytes(&stage.type, sizeof(stage.type), hash);
+		hash = hashBytes(stage.source.data(), stage.source.size(), hash);
+
+		// keeps "ab" + "c" apart from "a" + "bc"
+		uint64_t size = stage.source.size();
+		hash = hashBytes(&size, sizeof(size), hash);
+	}
+
+	return hash;
+}
+
+GLuint ProgramCache::load(uint64_t key)
+{
+	if (!enabled) { return 0; }
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::string path = getEntryPath(key);
+	std::ifstream f(path, std::ios::binary);
+	if (!f.is_open()) { return 0; }
+
+	CacheEntryHeader header = {};
+	f.read((char*)&header, sizeof(header));
+
+	bool valid = f.good() &&
+		memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+		header.version == cacheVersion &&
+		header.key == key &&
+		header.driverHash == driverHash &&
+		header.length > 0;
+
+	std::vector<char> binary;
+	if (valid)
+	{
+		binary.resize(header.length);
+		f.read(binary.data(), header.length);
+		valid = f.gcount() == (std::streamsize)header.length;
+	}
+	f.close();
+
+	std::error_code error;
+
+	if (!valid)
+	{
+		totalBytes -= std::min(totalBytes, getFileSize(path));
+		std::filesystem::remove(path, error);
+		return 0;
+	}
+
+	GLuint id = glCreateProgram();
+	glProgramBinary(id, header.format, binary.data(), (GLsizei)header.length);
+
+	GLint info = 0;
+	glGetProgramiv(id, GL_LINK_STATUS, &info);
+
+	if (info != GL_TRUE)
+	{
+		// the driver changed under the same version string, rebuild from source
+		glDeleteProgram(id);
+		totalBytes -= std::min(totalBytes, getFileSize(path));
+		std::filesystem::remove(path, error);
+		return 0;
+	}
+
+	// most recently used entries survive eviction
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+	return id;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program)
+{
+	if (!enabled || !program) { return; }
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) { return; }
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0) { return; }
+
+	CacheEntryHeader header = {};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.key = key;
+	header.driverHash = driverHash;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// write to the side and rename so a crash never leaves a torn entry behind
+	std::string path = getEntryPath(key);
+	std::string tempPath = path + ".tmp";
+
+	{
+		std::ofstream f(tempPath, std::ios::binary | std::ios::trunc);
+		if (!f.is_open())
+		{
+			std::cout << "Error writing shader cache entry " << tempPath << "\n";
+			return;
+		}
+
+		f.write((const char*)&header, sizeof(header));
+		f.write(binary.data(), length);
+	}
+
+	// an entry written over replaces its old size
+	uint64_t replaced = getFileSize(path);
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+
+	totalBytes = totalBytes - std::min(totalBytes, replaced) + sizeof(header) + length;
+	if (totalBytes > maxBytes) { evict(); }
+}
+
+std::string ProgramCache::getEntryPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return (std::filesystem::path(directory) / name).string();
+}
+
+void ProgramCache::evict()
+{
+	struct Entry
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type lastUse;
+		uint64_t size;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+
+	std::error_code error;
+	for (auto& file : std::filesystem::directory_iterator(directory, error))
+	{
+		if (file.path().extension() != ".bin") { continue; }
+
+		Entry e;
+		e.path = file.path();
+		e.lastUse = file.last_write_time(error);
+		e.size = file.file_size(error);
+		if (error) { continue; }
+
+		total += e.size;
+		entries.push_back(std::move(e));
+	}
+
+	totalBytes = total;
+	if (total <= maxBytes) { return; }
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+
+	for (auto& e : entries)
+	{
+		if (total <= maxBytes) { break; }
+
+		std::filesystem::remove(e.path, error);
+		total -= e.size;
+	}
+	totalBytes = total;
+}
+
+std::string getDefaultProgramCacheDirectory()
+{
+#ifdef _WIN32
+	if (const char* localAppData = std::getenv("LOCALAPPDATA"))
+	{
+		return (std::filesystem::path(localAppData) / "ShaderToy" / "programs").string();
+	}
+#else
+	if (const char* xdgCache = std::getenv("XDG_CACHE_HOME"))
+	{
+		return (std::filesystem::path(xdgCache) / "ShaderToy" / "programs").string();
+	}
+	if (const char* home = std::getenv("HOME"))
+	{
+		return (std::filesystem::path(home) / ".cache" / "ShaderToy" / "programs").string();
+	}
+#endif
+	return "shadercache";
+}
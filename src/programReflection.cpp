@@ -0,0 +1,295 @@
+#include <programReflection.h>
+#include <iostream>
+#include <algorithm>
+
+bool ProgramReflection::reflect(GLuint program)
+{
+	this->program = program;
+	uniforms.clear();
+	blocks.clear();
+	if (!program) { return false; }
+
+	GLint count = 0;
+	GLint maxNameLength = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+	const GLenum properties[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX, GL_OFFSET };
+	const GLsizei propertyCount = sizeof(properties) / sizeof(properties[0]);
+
+	std::vector<char> name(std::max(maxNameLength, 1));
+	uniforms.reserve(count);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint values[propertyCount] = {};
+		glGetProgramResourceiv(program, GL_UNIFORM, i, propertyCount, properties, propertyCount, nullptr, values);
+
+		GLsizei length = 0;
+		glGetProgramResourceName(program, GL_UNIFORM, i, (GLsizei)name.size(), &length, name.data());
+
+		UniformInfo u;
+		u.name.assign(name.data(), length);
+		if (u.name.size() > 3 && u.name.compare(u.name.size() - 3, 3, "[0]") == 0)
+		{
+			u.name.resize(u.name.size() - 3);
+		}
+
+		u.type = (GLenum)values[0];
+		u.location = values[1];
+		u.arraySize = values[2];
+		u.blockIndex = values[3];
+		u.offset = values[4];
+
+		uniforms.push_back(std::move(u));
+	}
+
+	GLint blockCount = 0;
+	maxNameLength = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockCount);
+	glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxNameLength);
+	name.resize(std::max(maxNameLength, 1));
+
+	const GLenum blockProperties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		GLint values[2] = {};
+		glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, i, 2, blockProperties, 2, nullptr, values);
+
+		GLsizei length = 0;
+		glGetProgramResourceName(program, GL_UNIFORM_BLOCK, i, (GLsizei)name.size(), &length, name.data());
+
+		UniformBlockInfo b;
+		b.name.assign(name.data(), length);
+		b.index = (GLuint)i;
+		b.binding = values[0];
+		b.dataSize = values[1];
+		blocks.push_back(std::move(b));
+	}
+
+	return true;
+}
+
+const UniformInfo* ProgramReflection::find(const std::string& name) const
+{
+	for (auto& u : uniforms)
+	{
+		if (u.name == name) { return &u; }
+	}
+	return nullptr;
+}
+
+const UniformBlockInfo* ProgramReflection::findBlock(const std::string& name) const
+{
+	for (auto& b : blocks)
+	{
+		if (b.name == name) { return &b; }
+	}
+	return nullptr;
+}
+
+const char* getBuiltinUniformName(BuiltinUniform u)
+{
+	switch (u)
+	{
+	case UniformResolution: return "iResolution";
+	case UniformTime: return "iTime";
+	case UniformTimeDelta: return "iTimeDelta";
+	case UniformFrameRate: return "iFrameRate";
+	case UniformFrame: return "iFrame";
+	case UniformMouse: return "iMouse";
+	case UniformDate: return "iDate";
+	case UniformTileOffset: return "iTileOffset";
+	default: return "";
+	}
+}
+
+// f(start, length) for every identifier outside comments and the block declaration
+template <class F>
+static void forEachIdentifier(const std::string& source, F f)
+{
+	// the block declaration names every member, leave it out
+	size_t skipBegin = source.find(ShaderToyInputsBlockName);
+	size_t skipEnd = skipBegin != std::string::npos ? source.find('}', skipBegin) : std::string::npos;
+
+	size_t i = 0;
+	while (i < source.size())
+	{
+		char c = source[i];
+		char next = i + 1 < source.size() ? source[i + 1] : 0;
+
+		if (i == skipBegin && skipEnd != std::string::npos)
+		{
+			i = skipEnd + 1;
+		}
+		else if (c == '/' && next == '/')
+		{
+			i = source.find('\n', i);
+		}
+		else if (c == '/' && next == '*')
+		{
+			i = source.find("*/", i + 2);
+			if (i != std::string::npos) { i += 2; }
+		}
+		else if (isalpha((unsigned char)c) || c == '_')
+		{
+			size_t start = i;
+			while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_')) { i++; }
+			f(start, i - start);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+unsigned int findReferencedBuiltins(const std::string& source)
+{
+	unsigned int referenced = 0;
+	forEachIdentifier(source, [&](size_t start, size_t length)
+	{
+		for (int u = 0; u < BuiltinUniformCount; u++)
+		{
+			if (source.compare(start, length, getBuiltinUniformName((BuiltinUniform)u)) == 0)
+			{
+				referenced |= 1u << u;
+			}
+		}
+	});
+	return referenced;
+}
+
+bool referencesIdentifier(const std::string& source, const char* name)
+{
+	bool found = false;
+	forEachIdentifier(source, [&](size_t start, size_t length)
+	{
+		found = found || source.compare(start, length, name) == 0;
+	});
+	return found;
+}
+
+static bool isSupportedType(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT:
+	case GL_FLOAT_VEC2:
+	case GL_FLOAT_VEC3:
+	case GL_FLOAT_VEC4:
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void packShaderToyInputs(const BuiltinUniformValues& values, ShaderToyInputs& out)
+{
+	std::copy(values.resolution, values.resolution + 3, out.iResolution);
+	out.iTime = values.time;
+	std::copy(values.mouse, values.mouse + 4, out.iMouse);
+	std::copy(values.date, values.date + 4, out.iDate);
+	out.iTimeDelta = values.timeDelta;
+	out.iFrameRate = values.frameRate;
+	out.iFrame = values.frame;
+	out.padding = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		std::copy(values.channelResolution[i], values.channelResolution[i] + 3, out.iChannelResolution[i]);
+		out.iChannelResolution[i][3] = 0;
+	}
+
+	out.iTileOffset[0] = values.tileOffset[0];
+	out.iTileOffset[1] = values.tileOffset[1];
+	out.iSampleCount = values.sampleCount;
+	out.padding2 = 0;
+}
+
+void BuiltinUniformTable::build(const ProgramReflection& reflection, const std::string& fragmentSource)
+{
+	bindings.clear();
+	usesInputsBlock = false;
+	blockReferences = fragmentSource.empty() ? ~0u : findReferencedBuiltins(fragmentSource);
+
+	if (const UniformBlockInfo* block = reflection.findBlock(ShaderToyInputsBlockName))
+	{
+		if (block->dataSize > (GLint)sizeof(ShaderToyInputs))
+		{
+			std::cout << "The " << block->name << " block doesn't match the built-in layout, it won't be bound\n";
+		}
+		else
+		{
+			// covers shaders that leave out the binding qualifier
+			if (block->binding != (GLint)ShaderToyInputsBinding)
+			{
+				glUniformBlockBinding(reflection.program, block->index, ShaderToyInputsBinding);
+			}
+			usesInputsBlock = true;
+		}
+	}
+
+	for (int i = 0; i < BuiltinUniformCount; i++)
+	{
+		auto builtin = (BuiltinUniform)i;
+
+		// uniforms the optimizer dropped are simply not in the list
+		const UniformInfo* u = reflection.find(getBuiltinUniformName(builtin));
+		if (!u || u->location < 0) { continue; }
+
+		if (!isSupportedType(u->type))
+		{
+			std::cout << "Built-in uniform " << u->name << " has an unsupported type, it won't be set\n";
+			continue;
+		}
+
+		bindings.push_back({ builtin, u->location, u->type });
+	}
+}
+
+bool BuiltinUniformTable::uses(BuiltinUniform u) const
+{
+	if (usesInputsBlock && (blockReferences & (1u << u))) { return true; }
+
+	for (auto& b : bindings)
+	{
+		if (b.builtin == u) { return true; }
+	}
+	return false;
+}
+
+void BuiltinUniformTable::upload(const BuiltinUniformValues& values) const
+{
+	for (auto& b : bindings)
+	{
+		// widest form of the value, the declared type picks how much of it is sent
+		float v[4] = {};
+		switch (b.builtin)
+		{
+		case UniformResolution: std::copy(values.resolution, values.resolution + 3, v); break;
+		case UniformTime: v[0] = values.time; break;
+		case UniformTimeDelta: v[0] = values.timeDelta; break;
+		case UniformFrameRate: v[0] = values.frameRate; break;
+		case UniformFrame: v[0] = (float)values.frame; break;
+		case UniformMouse: std::copy(values.mouse, values.mouse + 4, v); break;
+		case UniformDate: std::copy(values.date, values.date + 4, v); break;
+		case UniformTileOffset: std::copy(values.tileOffset, values.tileOffset + 2, v); break;
+		default: break;
+		}
+
+		switch (b.type)
+		{
+		case GL_FLOAT: glUniform1fv(b.location, 1, v); break;
+		case GL_FLOAT_VEC2: glUniform2fv(b.location, 1, v); break;
+		case GL_FLOAT_VEC3: glUniform3fv(b.location, 1, v); break;
+		case GL_FLOAT_VEC4: glUniform4fv(b.location, 1, v); break;
+		case GL_INT: glUniform1i(b.location, b.builtin == UniformFrame ? values.frame : (GLint)v[0]); break;
+		case GL_UNSIGNED_INT: glUniform1ui(b.location, b.builtin == UniformFrame ? (GLuint)values.frame : (GLuint)v[0]); break;
+		default: break;
+		}
+	}
+}
@@ -0,0 +1,141 @@
+#include <readbackRing.h>
+#include <iostream>
+
+bool ReadbackRing::init(int width, int height, int slotCount)
+{
+	clear();
+
+	this->width = width;
+	this->height = height;
+	this->slotCount = slotCount;
+	frameBytes = (size_t)width * height * 4;
+
+	slots.reset(new Slot[slotCount]);
+	for (int i = 0; i < slotCount; i++)
+	{
+		glGenBuffers(1, &slots[i].buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	return true;
+}
+
+void ReadbackRing::clear()
+{
+	for (int i = 0; i < slotCount; i++)
+	{
+		Slot& s = slots[i];
+		if (s.fence) { glDeleteSync(s.fence); }
+		if (s.mapped)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteBuffers(1, &s.buffer);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slots.reset();
+	slotCount = 0;
+	inFlight.clear();
+}
+
+void ReadbackRing::recycleReleased()
+{
+	for (int i = 0; i < slotCount; i++)
+	{
+		Slot& s = slots[i];
+		if (s.state.load(std::memory_order_acquire) != SlotReleased) { continue; }
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		s.mapped = nullptr;
+		s.state.store(SlotFree, std::memory_order_relaxed);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool ReadbackRing::capture(long long tag, int x, int y)
+{
+	if (!slotCount) { return false; }
+
+	recycleReleased();
+
+	int freeSlot = -1;
+	for (int i = 0; i < slotCount; i++)
+	{
+		if (slots[i].state.load(std::memory_order_relaxed) == SlotFree) { freeSlot = i; break; }
+	}
+	if (freeSlot < 0) { return false; }
+
+	Slot& s = slots[freeSlot];
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	s.tag = tag;
+	s.state.store(SlotInFlight, std::memory_order_relaxed);
+	inFlight.push_back(freeSlot);
+
+	return true;
+}
+
+bool ReadbackRing::acquire(ReadbackFrame& frame, bool wait)
+{
+	recycleReleased();
+
+	if (inFlight.empty()) { return false; }
+
+	Slot& s = slots[inFlight.front()];
+
+	if (wait)
+	{
+		while (glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+	}
+	else
+	{
+		// the flush makes sure the fence gets to the GPU even if nobody waits on it
+		GLenum status = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status == GL_TIMEOUT_EXPIRED) { return false; }
+	}
+
+	glDeleteSync(s.fence);
+	s.fence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+	s.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	int slot = inFlight.front();
+	inFlight.erase(inFlight.begin());
+
+	if (!s.mapped)
+	{
+		std::cout << "Error mapping readback buffer\n";
+		s.state.store(SlotFree, std::memory_order_relaxed);
+		return false;
+	}
+
+	s.state.store(SlotMapped, std::memory_order_relaxed);
+
+	frame.pixels = s.mapped;
+	frame.width = width;
+	frame.height = height;
+	frame.stride = (size_t)width * 4;
+	frame.tag = s.tag;
+	frame.slot = slot;
+	return true;
+}
+
+void ReadbackRing::release(const ReadbackFrame& frame)
+{
+	if (frame.slot < 0 || frame.slot >= slotCount) { return; }
+
+	// unmapping needs the GL thread, it happens on the next capture or acquire
+	slots[frame.slot].state.store(SlotReleased, std::memory_order_release);
+}
@@ -0,0 +1,467 @@
+#include <renderGraph.h>
+#include <textureFile.h>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+
+static const char* const passNames[RenderPassCount] = { "Buffer A", "Buffer B", "Buffer C", "Buffer D", "Image" };
+static const char* const passFileNames[RenderPassCount] = { "bufferA.frag", "bufferB.frag", "bufferC.frag", "bufferD.frag", "fragment.frag" };
+
+const char* getRenderPassName(int pass)
+{
+	return pass >= 0 && pass < RenderPassCount ? passNames[pass] : "";
+}
+
+const char* getRenderPassFileName(int pass)
+{
+	return pass >= 0 && pass < RenderPassCount ? passFileNames[pass] : "";
+}
+
+int findRenderPass(const std::string& name)
+{
+	for (int i = 0; i < RenderPassCount; i++)
+	{
+		if (name == passNames[i]) { return i; }
+	}
+	return -1;
+}
+
+void parseChannelBindings(const std::string& source, int channels[ChannelCount], std::string files[ChannelCount])
+{
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		channels[c] = -1;
+		files[c].clear();
+	}
+
+	std::istringstream in(source);
+	std::string line;
+	while (std::getline(in, line))
+	{
+		// the bindings sit in the prelude, nothing after the user code marker counts
+		if (line.find("// BEGIN_USER_CODE") != std::string::npos) { break; }
+
+		int c = -1;
+		char name[260] = {};
+		if (sscanf(line.c_str(), " // iChannel%d: %259[^\r\n]", &c, name) != 2) { continue; }
+		if (c < 0 || c >= ChannelCount) { continue; }
+
+		int pass = findRenderPass(name);
+		if (pass >= 0 && pass != PassImage)
+		{
+			channels[c] = pass;
+		}
+		else if (isChannelFileName(name))
+		{
+			files[c] = name;
+		}
+		else
+		{
+			std::cout << "Unknown source \"" << name << "\" for iChannel" << c << ", left unbound\n";
+		}
+	}
+}
+
+std::string formatChannelBindings(const int channels[ChannelCount], const std::string files[ChannelCount])
+{
+	std::string out;
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		if (channels[c] >= 0)
+		{
+			out += "// iChannel" + std::to_string(c) + ": " + getRenderPassName(channels[c]) + "\n";
+		}
+		else if (!files[c].empty())
+		{
+			out += "// iChannel" + std::to_string(c) + ": " + files[c] + "\n";
+		}
+	}
+	return out;
+}
+
+bool RenderGraph::init(FullscreenQuad* quad)
+{
+	this->quad = quad;
+	passes[PassImage].enabled = true;
+
+	// several passes write the block each frame, give each of them room in the ring
+	return inputsRing.init(sizeof(ShaderToyInputs), 3 * RenderPassCount);
+}
+
+void RenderGraph::clear()
+{
+	for (auto& p : passes)
+	{
+		deleteTargets(p);
+		p.shader.clear();
+		p.reflection = ProgramReflection();
+		p.builtinUniforms = BuiltinUniformTable();
+	}
+	inputsRing.clear();
+	width = height = 0;
+}
+
+void RenderGraph::setProgram(int pass, GLuint program, const std::string& fragmentSource)
+{
+	RenderPass& p = passes[pass];
+	p.shader.clear();
+	p.shader.id = program;
+	version++;
+
+	p.reflection = ProgramReflection();
+	p.builtinUniforms = BuiltinUniformTable();
+	if (!program) { return; }
+
+	p.reflection.reflect(program);
+	p.builtinUniforms.build(p.reflection, fragmentSource);
+
+	// iChannelN always samples texture unit N
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		const UniformInfo* u = p.reflection.find("iChannel" + std::to_string(c));
+		if (u && u->location >= 0) { glProgramUniform1i(program, u->location, c); }
+	}
+}
+
+void RenderGraph::setEnabled(int pass, bool enabled)
+{
+	if (pass == PassImage || passes[pass].enabled == enabled) { return; }
+
+	RenderPass& p = passes[pass];
+	p.enabled = enabled;
+	if (enabled)
+	{
+		if (width > 0 && height > 0) { createTargets(p); }
+	}
+	else
+	{
+		deleteTargets(p);
+		p.shader.clear();
+	}
+	orderDirty = true;
+	version++;
+}
+
+void RenderGraph::setChannel(int pass, int channel, int source)
+{
+	RenderPass& p = passes[pass];
+	if (p.channels[channel] == source && p.channelFiles[channel].empty()) { return; }
+
+	p.channels[channel] = source;
+	p.channelFiles[channel].clear();
+	setChannelTexture(pass, channel, ChannelTexture());
+	orderDirty = true;
+	version++;
+}
+
+void RenderGraph::setChannelFile(int pass, int channel, const std::string& file)
+{
+	RenderPass& p = passes[pass];
+	if (p.channels[channel] < 0 && p.channelFiles[channel] == file) { return; }
+
+	p.channels[channel] = -1;
+	p.channelFiles[channel] = file;
+	setChannelTexture(pass, channel, ChannelTexture());
+	orderDirty = true;
+	version++;
+}
+
+void RenderGraph::setChannelBindings(int pass, const std::string& source)
+{
+	int channels[ChannelCount];
+	std::string files[ChannelCount];
+	parseChannelBindings(source, channels, files);
+
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		if (!files[c].empty()) { setChannelFile(pass, c, files[c]); }
+		else { setChannel(pass, c, channels[c]); }
+	}
+}
+
+void RenderGraph::setChannelTexture(int pass, int channel, const ChannelTexture& texture)
+{
+	RenderPass& p = passes[pass];
+	if (p.channelTextures[channel] == texture) { return; }
+
+	p.channelTextures[channel] = texture;
+	version++;
+}
+
+void RenderGraph::resetBuffers()
+{
+	version++;
+
+	const float zero[4] = {};
+	for (int i = 0; i < PassImage; i++)
+	{
+		for (GLuint t : passes[i].textures)
+		{
+			if (t) { glClearTexImage(t, 0, GL_RGBA, GL_FLOAT, zero); }
+		}
+	}
+}
+
+bool RenderGraph::uses(BuiltinUniform u) const
+{
+	for (auto& p : passes)
+	{
+		if (p.enabled && p.shader.id && p.builtinUniforms.uses(u)) { return true; }
+	}
+	return false;
+}
+
+bool RenderGraph::passUses(int pass, BuiltinUniform u) const
+{
+	const RenderPass& p = passes[pass];
+	return p.enabled && p.shader.id && p.builtinUniforms.uses(u);
+}
+
+const std::vector<int>& RenderGraph::getOrder()
+{
+	if (orderDirty) { updateOrder(); }
+	return order;
+}
+
+bool RenderGraph::hasFeedback()
+{
+	if (orderDirty) { updateOrder(); }
+	return feedback;
+}
+
+void RenderGraph::updateOrder()
+{
+	// Kahn's algorithm over "reads" edges between buffers, lowest pass first on ties.
+	// Self reads and cycles can't be ordered, those channels simply see the last frame.
+	int dependencies[PassImage] = {};
+	for (int i = 0; i < PassImage; i++)
+	{
+		if (!passes[i].enabled) { continue; }
+		for (int source : passes[i].channels)
+		{
+			if (source >= 0 && source < PassImage && source != i && passes[source].enabled) { dependencies[i] |= 1 << source; }
+		}
+	}
+
+	order.clear();
+	int done = 0;
+	bool progress = true;
+	while (progress)
+	{
+		progress = false;
+		for (int i = 0; i < PassImage; i++)
+		{
+			if (!passes[i].enabled || (done & (1 << i)) || (dependencies[i] & ~done)) { continue; }
+			order.push_back(i);
+			done |= 1 << i;
+			progress = true;
+			break;
+		}
+	}
+
+	for (int i = 0; i < PassImage; i++)
+	{
+		if (passes[i].enabled && !(done & (1 << i))) { order.push_back(i); }
+	}
+
+	// a buffer reading one that hasn't run yet this frame carries state over
+	feedback = false;
+	int ran = 0;
+	for (int i : order)
+	{
+		for (int source : passes[i].channels)
+		{
+			if (source >= 0 && source < PassImage && passes[source].enabled && !(ran & (1 << source))) { feedback = true; }
+		}
+		ran |= 1 << i;
+	}
+
+	orderDirty = false;
+}
+
+void RenderGraph::createTargets(RenderPass& p)
+{
+	deleteTargets(p);
+
+	glGenTextures(2, p.textures);
+	glGenFramebuffers(2, p.framebuffers);
+
+	const float zero[4] = {};
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, p.textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glClearTexImage(p.textures[i], 0, GL_RGBA, GL_FLOAT, zero);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, p.framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, p.textures[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Render pass framebuffer is incomplete\n";
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	p.front = 0;
+}
+
+void RenderGraph::deleteTargets(RenderPass& p)
+{
+	if (p.framebuffers[0]) { glDeleteFramebuffers(2, p.framebuffers); }
+	if (p.textures[0]) { glDeleteTextures(2, p.textures); }
+	p.framebuffers[0] = p.framebuffers[1] = 0;
+	p.textures[0] = p.textures[1] = 0;
+	p.front = 0;
+}
+
+void RenderGraph::render(const BuiltinUniformValues& inputs, int width, int height, const ImageTarget& image, GpuTimer* timer)
+{
+	renderBuffers(inputs, width, height, timer);
+	renderImage(inputs, image, timer);
+}
+
+void RenderGraph::renderBuffers(const BuiltinUniformValues& inputs, int width, int height, GpuTimer* timer)
+{
+	if (width <= 0 || height <= 0) { return; }
+
+	if (width != this->width || height != this->height)
+	{
+		// buffer contents don't survive a resize, same as on shadertoy.com
+		this->width = width;
+		this->height = height;
+		for (int i = 0; i < PassImage; i++)
+		{
+			if (passes[i].enabled) { createTargets(passes[i]); }
+		}
+	}
+
+	if (orderDirty) { updateOrder(); }
+
+	BuiltinUniformValues values = inputs;
+	values.resolution[0] = (float)width;
+	values.resolution[1] = (float)height;
+	values.resolution[2] = 1.0f;
+	values.tileOffset[0] = values.tileOffset[1] = 0.0f;
+
+	glViewport(0, 0, width, height);
+
+	for (int pass : order)
+	{
+		RenderPass& p = passes[pass];
+		if (!p.shader.id) { continue; }
+
+		int back = 1 - p.front;
+		glBindFramebuffer(GL_FRAMEBUFFER, p.framebuffers[back]);
+		drawPass(pass, values, width, height, timer);
+		p.front = back;
+	}
+}
+
+void RenderGraph::renderImage(const BuiltinUniformValues& inputs, const ImageTarget& image, GpuTimer* timer)
+{
+	RenderPass& p = passes[PassImage];
+	if (!p.shader.id || image.width <= 0 || image.height <= 0) { return; }
+
+	BuiltinUniformValues values = inputs;
+	values.resolution[0] = (float)image.width;
+	values.resolution[1] = (float)image.height;
+	values.resolution[2] = 1.0f;
+
+	if (width > 0 && height > 0 && (image.width != width || image.height != height))
+	{
+		// a scaled down image, its pixels are bigger
+		float sx = (float)image.width / width;
+		float sy = (float)image.height / height;
+		values.mouse[0] *= sx;
+		values.mouse[1] *= sy;
+		values.mouse[2] *= sx;
+		values.mouse[3] *= sy;
+	}
+
+	int drawWidth = image.width, drawHeight = image.height;
+	values.tileOffset[0] = values.tileOffset[1] = 0.0f;
+	if (image.tileWidth > 0 && image.tileHeight > 0)
+	{
+		drawWidth = image.tileWidth;
+		drawHeight = image.tileHeight;
+		values.tileOffset[0] = (float)image.tileX;
+		values.tileOffset[1] = (float)image.tileY;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, image.framebuffer);
+	glViewport(0, 0, drawWidth, drawHeight);
+	drawPass(PassImage, values, drawWidth, drawHeight, timer);
+
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void RenderGraph::drawPass(int pass, BuiltinUniformValues& values, int drawWidth, int drawHeight, GpuTimer* timer)
+{
+	RenderPass& p = passes[pass];
+	p.shader.bind();
+
+	for (int c = 0; c < ChannelCount; c++)
+	{
+		int source = p.channels[c];
+		ChannelTexture texture;
+		if (source >= 0 && source < PassImage && passes[source].enabled)
+		{
+			// front is this frame's output if the source already ran, otherwise the last one's
+			texture.id = passes[source].textures[passes[source].front];
+			texture.size[0] = width;
+			texture.size[1] = height;
+			texture.size[2] = 1;
+		}
+		else if (p.channelTextures[c].id)
+		{
+			texture = p.channelTextures[c];
+		}
+
+		// the unit's other targets keep whatever they had, the sampler type picks one
+		glActiveTexture(GL_TEXTURE0 + c);
+		glBindTexture(texture.target, texture.id);
+
+		values.channelResolution[c][0] = (float)texture.size[0];
+		values.channelResolution[c][1] = (float)texture.size[1];
+		values.channelResolution[c][2] = (float)texture.size[2];
+	}
+
+	if (p.builtinUniforms.usesInputsBlock)
+	{
+		ShaderToyInputs block;
+		packShaderToyInputs(values, block);
+		inputsRing.write(&block, ShaderToyInputsBinding);
+	}
+	p.builtinUniforms.upload(values);
+
+	if (timer) { timer->beginPass(getRenderPassName(pass)); }
+
+	if (submitTileSize > 0 && (drawWidth > submitTileSize || drawHeight > submitTileSize))
+	{
+		// one flush per tile so no single submission runs long enough to trip the
+		// driver's watchdog; the scissor leaves gl_FragCoord alone
+		glEnable(GL_SCISSOR_TEST);
+		for (int y = 0; y < drawHeight; y += submitTileSize)
+		{
+			for (int x = 0; x < drawWidth; x += submitTileSize)
+			{
+				glScissor(x, y, submitTileSize, submitTileSize);
+				quad->draw();
+				glFlush();
+			}
+		}
+		glDisable(GL_SCISSOR_TEST);
+	}
+	else
+	{
+		quad->draw();
+	}
+
+	if (timer) { timer->endPass(); }
+	inputsRing.fence();
+}
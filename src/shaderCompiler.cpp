@@ -0,0 +1,256 @@
+#include <shaderCompiler.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+bool ShaderCompileService::init(GLFWwindow* mainWindow, ProgramCache* cache)
+{
+	this->cache = cache;
+
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile") ||
+		glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+	{
+		auto maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (!maxThreads)
+		{
+			maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+
+		if (maxThreads)
+		{
+			maxThreads(0xFFFFFFFF); // let the driver pick
+			parallelCompile = true;
+			return true;
+		}
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	workerWindow = glfwCreateWindow(1, 1, "ShaderToy compiler", nullptr, mainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (!workerWindow)
+	{
+		std::cout << "Failed to create the shader compiler context\n";
+		return false;
+	}
+
+	running = true;
+	worker = std::thread(&ShaderCompileService::workerLoop, this);
+	return true;
+}
+
+void ShaderCompileService::shutdown()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+
+	for (auto& p : pending) { discard(p); }
+	pending.clear();
+	jobs.clear();
+
+	if (workerWindow)
+	{
+		glfwDestroyWindow(workerWindow);
+		workerWindow = nullptr;
+	}
+}
+
+unsigned int ShaderCompileService::submit(const std::vector<ShaderStageSource>& stages, int slot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Job j;
+	j.ticket = ++nextTicket;
+	j.slot = slot;
+	j.stages = stages;
+
+	if (parallelCompile)
+	{
+		// the driver compiles in the background, glCompileShader/glLinkProgram return right away
+		discardSlot(pending, slot);
+		pending.emplace_back();
+		build(j, pending.back());
+	}
+	else
+	{
+		for (auto it = jobs.begin(); it != jobs.end(); ++it)
+		{
+			if (it->slot == slot) { jobs.erase(it); break; }
+		}
+		jobs.push_back(std::move(j));
+		wake.notify_one();
+	}
+
+	return nextTicket;
+}
+
+bool ShaderCompileService::poll(CompileResult& result)
+{
+	PendingProgram p;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = pending.begin();
+		while (it != pending.end() && !isComplete(*it)) { ++it; }
+		if (it == pending.end())
+		{
+			return false;
+		}
+
+		p = std::move(*it);
+		pending.erase(it);
+	}
+
+	finish(p, result);
+	return true;
+}
+
+bool ShaderCompileService::isBusy() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !jobs.empty() || !pending.empty() || building;
+}
+
+void ShaderCompileService::discardSlot(std::vector<PendingProgram>& programs, int slot)
+{
+	for (auto it = programs.begin(); it != programs.end(); ++it)
+	{
+		if (it->slot == slot)
+		{
+			discard(*it);
+			programs.erase(it);
+			return;
+		}
+	}
+}
+
+void ShaderCompileService::workerLoop()
+{
+	glfwMakeContextCurrent(workerWindow);
+
+	while (true)
+	{
+		Job j;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return !jobs.empty() || !running; });
+			if (!running) { break; }
+
+			j = std::move(jobs.front());
+			jobs.erase(jobs.begin());
+			building = true;
+		}
+
+		PendingProgram p;
+		build(j, p);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		building = false;
+
+		bool superseded = false;
+		for (auto& queued : jobs)
+		{
+			if (queued.slot == j.slot) { superseded = true; }
+		}
+
+		if (superseded)
+		{
+			// a newer edit is already queued, don't bother swapping this one in
+			discard(p);
+			continue;
+		}
+
+		discardSlot(pending, j.slot);
+		pending.push_back(std::move(p));
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+void ShaderCompileService::build(const Job& j, PendingProgram& out)
+{
+	out.ticket = j.ticket;
+	out.slot = j.slot;
+	for (auto& s : j.stages)
+	{
+		if (s.type == GL_FRAGMENT_SHADER) { out.fragmentSource = s.source; }
+	}
+
+	if (parallelCompile)
+	{
+		// statuses are only queried once GL_COMPLETION_STATUS_KHR says so, anything earlier would block
+		out.build = beginProgramBuild(j.stages, cache);
+		return;
+	}
+
+	// worker context: blocking here is fine, the render thread never waits on it
+	out.program = buildProgram(j.stages, out.diagnostics, cache);
+	out.finished = true;
+
+	if (out.program)
+	{
+		// the main context may only use the program once the worker's commands have executed
+		out.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	glFlush();
+}
+
+bool ShaderCompileService::isComplete(const PendingProgram& p) const
+{
+	if (!p.finished)
+	{
+		GLint done = GL_FALSE;
+		glGetProgramiv(p.build.program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+
+	if (!p.fence) { return true; }
+
+	GLenum status = glClientWaitSync(p.fence, 0, 0);
+	return status != GL_TIMEOUT_EXPIRED;
+}
+
+void ShaderCompileService::finish(PendingProgram& p, CompileResult& result)
+{
+	if (!p.finished)
+	{
+		p.program = finishProgramBuild(p.build, p.diagnostics);
+		p.finished = true;
+	}
+
+	if (p.fence)
+	{
+		glDeleteSync(p.fence);
+		p.fence = 0;
+	}
+
+	result.ticket = p.ticket;
+	result.slot = p.slot;
+	result.success = p.program != 0;
+	result.program = p.program;
+	result.diagnostics = std::move(p.diagnostics);
+	result.fragmentSource = std::move(p.fragmentSource);
+}
+
+void ShaderCompileService::discard(PendingProgram& p)
+{
+	cancelProgramBuild(p.build);
+	if (p.fence) { glDeleteSync(p.fence); }
+	if (p.program) { glDeleteProgram(p.program); }
+	p = PendingProgram();
+}
@@ -1,281 +1,401 @@
 #include <shaderLoader.h>
+#include <programCache.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
-//path is used for error reporting
-GLint createShaderFromData(const char* data, GLenum shaderType, const char* path = 0)
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
 {
-	GLuint shaderId = glCreateShader(shaderType);
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string getShaderLog(GLuint shaderId)
+{
+	GLint l = 0;
+	glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &l);
+	if (l <= 0) { return {}; }
+
+	std::string log(l, '\0');
+	glGetShaderInfoLog(shaderId, l, &l, &log[0]);
+	log.resize(l);
+	return log;
+}
+
+static std::string getProgramLog(GLuint programId)
+{
+	GLint l = 0;
+	glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &l);
+	if (l <= 0) { return {}; }
+
+	std::string log(l, '\0');
+	glGetProgramInfoLog(programId, l, &l, &log[0]);
+	log.resize(l);
+	return log;
+}
+
+static GLuint compileStage(const ShaderStageSource& stage)
+{
+	const char* data = stage.source.c_str();
+
+	GLuint shaderId = glCreateShader(stage.type);
 	glShaderSource(shaderId, 1, &data, nullptr);
 	glCompileShader(shaderId);
 
+	return shaderId;
+}
+
+static bool collectStage(GLuint shaderId, const ShaderStageSource& stage, ShaderStageDiagnostics& out)
+{
 	GLint rezult = 0;
 	glGetShaderiv(shaderId, GL_COMPILE_STATUS, &rezult);
 
-	if (!rezult)
+	out.type = stage.type;
+	out.name = stage.name;
+	out.compiled = rezult == GL_TRUE;
+	out.log = getShaderLog(shaderId);
+	if (!out.compiled)
 	{
-		char* message = 0;
-		int   l = 0;
+		out.lineMap = parseShaderLog(out.log, stage.lineOffset);
+	}
 
-		glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &l);
+	return out.compiled;
+}
 
-		if (l)
-		{
-			message = new char[l];
+static bool collectLink(GLuint programId, ShaderDiagnostics& diagnostics)
+{
+	GLint info = 0;
+	glGetProgramiv(programId, GL_LINK_STATUS, &info);
 
-			glGetShaderInfoLog(shaderId, l, &l, message);
+	diagnostics.linked = info == GL_TRUE;
+	diagnostics.linkLog = getProgramLog(programId);
 
-			message[l - 1] = 0;
+	return diagnostics.linked;
+}
 
-			std::cout << "error compiling shader: ";
-			if (path) { std::cout << path; }
-			std::cout << "\n" << message << "\n";
-			delete[] message;
-		}
-		else
-		{
-			if (path) { std::cout << path << " "; }
-			std::cout << "unknown error while compiling shader :(\n";
-		}
+static void fillCachedDiagnostics(const std::vector<ShaderStageSource>& stages, ShaderDiagnostics& diagnostics)
+{
+	diagnostics.stages.resize(stages.size());
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		diagnostics.stages[i].type = stages[i].type;
+		diagnostics.stages[i].name = stages[i].name;
+		diagnostics.stages[i].compiled = true;
+	}
+	diagnostics.linked = true;
+	diagnostics.fromCache = true;
+}
 
+static void releaseStages(GLuint programId, std::vector<GLuint>& shaderIds)
+{
+	for (auto shaderId : shaderIds)
+	{
+		if (programId) { glDetachShader(programId, shaderId); }
 		glDeleteShader(shaderId);
-
-		shaderId = 0;
-		return shaderId;
 	}
-
-	return shaderId;
+	shaderIds.clear();
 }
 
-
-GLint createShaderFromFile(const char* name, GLenum shaderType)
+const ShaderStageDiagnostics* ShaderDiagnostics::getStage(GLenum type) const
 {
-	std::ifstream f(name);
-	std::string str;
-
-	if (!f.is_open())
+	for (auto& stage : stages)
 	{
-		std::cout << "Error opening file: " + std::string(name) << "\n";
-		return 0;
+		if (stage.type == type) { return &stage; }
 	}
+	return nullptr;
+}
 
-	f.seekg(0, std::ios::end);
-	str.reserve(f.tellg());
-	f.seekg(0, std::ios::beg);
+std::string ShaderDiagnostics::getErrors() const
+{
+	std::string errors;
 
-	if (str.capacity() <= 0)
+	for (auto& stage : stages)
 	{
-		std::cout << "Error opening file: " + std::string(name) << "\n";
-		return 0;
-	}
-
-	str.assign((std::istreambuf_iterator<char>(f)),
-		std::istreambuf_iterator<char>());
+		if (stage.compiled) { continue; }
 
+		errors += "error compiling shader: " + stage.name + "\n";
+		errors += stage.log.empty() ? "unknown error while compiling shader :(\n" : stage.log;
+	}
 
-	auto rez = createShaderFromData(str.c_str(), shaderType, name);
+	if (errors.empty() && !linked)
+	{
+		errors = "Link error: " + linkLog;
+	}
 
-	return rez;
+	return errors;
 }
 
-bool Shader::loadShaderProgramFromData(const char* vertexShaderData, const char* fragmentShaderData)
+GLuint buildProgram(const std::vector<ShaderStageSource>& stages, ShaderDiagnostics& diagnostics,
+	ProgramCache* cache)
 {
-	auto vertexId = createShaderFromData(vertexShaderData, GL_VERTEX_SHADER);
-	auto fragmentId = createShaderFromData(fragmentShaderData, GL_FRAGMENT_SHADER);
+	diagnostics = ShaderDiagnostics();
 
-	if (vertexId == 0 || fragmentId == 0)
+	uint64_t cacheKey = 0;
+	if (cache && cache->isEnabled())
 	{
-		return 0;
-	}
+		auto start = std::chrono::steady_clock::now();
 
-	id = glCreateProgram();
-
-	glAttachShader(id, vertexId);
-	glAttachShader(id, fragmentId);
-
-	glLinkProgram(id);
+		cacheKey = cache->getKey(stages);
+		if (GLuint cached = cache->load(cacheKey))
+		{
+			fillCachedDiagnostics(stages, diagnostics);
+			diagnostics.linkMs = millisecondsSince(start);
+			return cached;
+		}
+	}
 
-	glDeleteShader(vertexId);
-	glDeleteShader(fragmentId);
+	diagnostics.stages.resize(stages.size());
 
-	GLint info = 0;
-	glGetProgramiv(id, GL_LINK_STATUS, &info);
+	std::vector<GLuint> shaderIds;
+	shaderIds.reserve(stages.size());
 
-	if (info != GL_TRUE)
+	bool compiled = true;
+	for (size_t i = 0; i < stages.size(); i++)
 	{
-		char* message = 0;
-		int   l = 0;
-
-		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &l);
+		auto start = std::chrono::steady_clock::now();
 
-		message = new char[l];
+		GLuint shaderId = compileStage(stages[i]);
+		shaderIds.push_back(shaderId);
 
-		glGetProgramInfoLog(id, l, &l, message);
+		// the status query is what actually waits for the compiler
+		compiled = collectStage(shaderId, stages[i], diagnostics.stages[i]) && compiled;
 
-		std::cout << std::string("Link error: ") + message << "\n";
-
-		delete[] message;
+		diagnostics.stages[i].compileMs = millisecondsSince(start);
+		diagnostics.compileMs += diagnostics.stages[i].compileMs;
+	}
+	diagnostics.stagesTimed = true;
 
-		glDeleteProgram(id);
-		id = 0;
+	if (!compiled)
+	{
+		releaseStages(0, shaderIds);
 		return 0;
 	}
 
-	glValidateProgram(id);
+	auto start = std::chrono::steady_clock::now();
 
-	return true;
-}
+	GLuint id = glCreateProgram();
 
-bool Shader::loadShaderProgramFromData(const char* vertexShaderData, const char* geometryShaderData, const char* fragmentShaderData)
-{
-	auto vertexId = createShaderFromData(vertexShaderData, GL_VERTEX_SHADER);
-	auto geometryId = createShaderFromData(geometryShaderData, GL_GEOMETRY_SHADER);
-	auto fragmentId = createShaderFromData(fragmentShaderData, GL_FRAGMENT_SHADER);
-
-	if (vertexId == 0 || fragmentId == 0 || geometryId == 0)
+	if (cacheKey)
 	{
-		return 0;
+		glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	}
 
-	id = glCreateProgram();
-
-	glAttachShader(id, vertexId);
-	glAttachShader(id, geometryId);
-	glAttachShader(id, fragmentId);
+	for (auto shaderId : shaderIds)
+	{
+		glAttachShader(id, shaderId);
+	}
 
 	glLinkProgram(id);
 
-	glDeleteShader(vertexId);
-	glDeleteShader(geometryId);
-	glDeleteShader(fragmentId);
+	bool linked = collectLink(id, diagnostics);
+	diagnostics.linkMs = millisecondsSince(start);
 
-	GLint info = 0;
-	glGetProgramiv(id, GL_LINK_STATUS, &info);
+	releaseStages(id, shaderIds);
 
-	if (info != GL_TRUE)
+	if (!linked)
 	{
-		char* message = 0;
-		int   l = 0;
-
-		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &l);
-
-		message = new char[l];
-
-		glGetProgramInfoLog(id, l, &l, message);
-
-		std::cout << std::string("Link error: ") + message << "\n";
-
-		delete[] message;
-
 		glDeleteProgram(id);
-		id = 0;
 		return 0;
 	}
 
 	glValidateProgram(id);
 
-	return true;
+	if (cacheKey)
+	{
+		cache->store(cacheKey, id);
+	}
+
+	return id;
 }
 
-bool Shader::loadShaderProgramFromFile(const char* vertexShader, const char* fragmentShader)
+ProgramBuild beginProgramBuild(const std::vector<ShaderStageSource>& stages, ProgramCache* cache)
 {
+	ProgramBuild build;
+	build.start = std::chrono::steady_clock::now();
+	build.stages = stages;
 
-	auto vertexId = createShaderFromFile(vertexShader, GL_VERTEX_SHADER);
-	auto fragmentId = createShaderFromFile(fragmentShader, GL_FRAGMENT_SHADER);
+	if (cache && cache->isEnabled())
+	{
+		build.cache = cache;
+		build.cacheKey = cache->getKey(stages);
 
+		// a restored binary is complete right away
+		build.program = cache->load(build.cacheKey);
+		if (build.program)
+		{
+			build.fromCache = true;
+			return build;
+		}
+	}
 
-	if (vertexId == 0 || fragmentId == 0)
+	for (auto& stage : stages)
 	{
-		return 0;
+		build.shaderIds.push_back(compileStage(stage));
 	}
 
-	id = glCreateProgram();
+	build.program = glCreateProgram();
 
-	glAttachShader(id, vertexId);
-	glAttachShader(id, fragmentId);
+	if (build.cache)
+	{
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 
-	glLinkProgram(id);
+	for (auto shaderId : build.shaderIds)
+	{
+		glAttachShader(build.program, shaderId);
+	}
 
-	glDeleteShader(vertexId);
-	glDeleteShader(fragmentId);
+	glLinkProgram(build.program);
 
-	GLint info = 0;
-	glGetProgramiv(id, GL_LINK_STATUS, &info);
+	return build;
+}
+
+GLuint finishProgramBuild(ProgramBuild& build, ShaderDiagnostics& diagnostics)
+{
+	diagnostics = ShaderDiagnostics();
 
-	if (info != GL_TRUE)
+	if (build.fromCache)
 	{
-		char* message = 0;
-		int   l = 0;
+		fillCachedDiagnostics(build.stages, diagnostics);
+		diagnostics.linkMs = millisecondsSince(build.start);
+
+		GLuint id = build.program;
+		build.program = 0;
+		return id;
+	}
 
-		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &l);
+	diagnostics.stages.resize(build.stages.size());
+
+	bool compiled = true;
+	for (size_t i = 0; i < build.stages.size(); i++)
+	{
+		compiled = collectStage(build.shaderIds[i], build.stages[i], diagnostics.stages[i]) && compiled;
+	}
 
-		message = new char[l];
+	bool linked = compiled && collectLink(build.program, diagnostics);
 
-		glGetProgramInfoLog(id, l, &l, message);
+	// compile and link overlapped in the driver, only the total is known
+	diagnostics.linkMs = millisecondsSince(build.start);
 
-		std::cout << std::string("Link error: ") + message << "\n";
+	releaseStages(build.program, build.shaderIds);
 
-		delete[] message;
+	GLuint id = build.program;
+	build.program = 0;
 
+	if (!linked)
+	{
 		glDeleteProgram(id);
-		id = 0;
 		return 0;
 	}
 
-	glValidateProgram(id);
+	if (build.cache)
+	{
+		build.cache->store(build.cacheKey, id);
+	}
 
-	return true;
+	return id;
 }
 
-bool Shader::loadShaderProgramFromFile(const char* vertexShader, const char* geometryShader, const char* fragmentShader)
+void cancelProgramBuild(ProgramBuild& build)
 {
-	auto vertexId = createShaderFromFile(vertexShader, GL_VERTEX_SHADER);
-	auto geometryId = createShaderFromFile(geometryShader, GL_GEOMETRY_SHADER);
-	auto fragmentId = createShaderFromFile(fragmentShader, GL_FRAGMENT_SHADER);
+	releaseStages(build.program, build.shaderIds);
 
-	if (vertexId == 0 || fragmentId == 0 || geometryId == 0)
+	if (build.program)
 	{
-		return 0;
+		glDeleteProgram(build.program);
+		build.program = 0;
 	}
+}
 
-	id = glCreateProgram();
+bool readShaderFile(const char* name, std::string& out)
+{
+	std::ifstream f(name);
 
-	glAttachShader(id, vertexId);
-	glAttachShader(id, geometryId);
-	glAttachShader(id, fragmentId);
+	if (!f.is_open())
+	{
+		std::cout << "Error opening file: " + std::string(name) << "\n";
+		return false;
+	}
 
-	glLinkProgram(id);
+	f.seekg(0, std::ios::end);
+	out.clear();
+	out.reserve(f.tellg());
+	f.seekg(0, std::ios::beg);
 
-	glDeleteShader(vertexId);
-	glDeleteShader(geometryId);
-	glDeleteShader(fragmentId);
+	if (out.capacity() <= 0)
+	{
+		std::cout << "Error opening file: " + std::string(name) << "\n";
+		return false;
+	}
 
-	GLint info = 0;
-	glGetProgramiv(id, GL_LINK_STATUS, &info);
+	out.assign((std::istreambuf_iterator<char>(f)),
+		std::istreambuf_iterator<char>());
+
+	return true;
+}
 
-	if (info != GL_TRUE)
+bool Shader::build(const std::vector<ShaderStageSource>& stages, ShaderDiagnostics* diagnostics,
+	ProgramCache* cache)
+{
+	ShaderDiagnostics localDiagnostics;
+	ShaderDiagnostics& diag = diagnostics ? *diagnostics : localDiagnostics;
+
+	GLuint newId = buildProgram(stages, diag, cache);
+
+	if (!newId)
 	{
-		char* message = 0;
-		int   l = 0;
+		if (!diagnostics) { std::cout << diag.getErrors() << "\n"; }
+		return false;
+	}
 
-		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &l);
+	if (id) { glDeleteProgram(id); }
+	id = newId;
 
-		message = new char[l];
+	return true;
+}
 
-		glGetProgramInfoLog(id, l, &l, message);
+bool Shader::loadShaderProgramFromData(const char* vertexShaderData, const char* fragmentShaderData)
+{
+	return build({
+		{ GL_VERTEX_SHADER, vertexShaderData },
+		{ GL_FRAGMENT_SHADER, fragmentShaderData } });
+}
 
-		std::cout << std::string("Link error: ") + message << "\n";
+bool Shader::loadShaderProgramFromData(const char* vertexShaderData, const char* geometryShaderData, const char* fragmentShaderData)
+{
+	return build({
+		{ GL_VERTEX_SHADER, vertexShaderData },
+		{ GL_GEOMETRY_SHADER, geometryShaderData },
+		{ GL_FRAGMENT_SHADER, fragmentShaderData } });
+}
 
-		delete[] message;
+bool Shader::loadShaderProgramFromFile(const char* vertexShader, const char* fragmentShader)
+{
+	std::string vertexData, fragmentData;
 
-		glDeleteProgram(id);
-		id = 0;
+	if (!readShaderFile(vertexShader, vertexData) || !readShaderFile(fragmentShader, fragmentData))
+	{
 		return 0;
 	}
 
-	glValidateProgram(id);
+	return build({
+		{ GL_VERTEX_SHADER, vertexData, vertexShader },
+		{ GL_FRAGMENT_SHADER, fragmentData, fragmentShader } });
+}
 
-	return true;
+bool Shader::loadShaderProgramFromFile(const char* vertexShader, const char* geometryShader, const char* fragmentShader)
+{
+	std::string vertexData, geometryData, fragmentData;
+
+	if (!readShaderFile(vertexShader, vertexData) || !readShaderFile(geometryShader, geometryData) ||
+		!readShaderFile(fragmentShader, fragmentData))
+	{
+		return 0;
+	}
+
+	return build({
+		{ GL_VERTEX_SHADER, vertexData, vertexShader },
+		{ GL_GEOMETRY_SHADER, geometryData, geometryShader },
+		{ GL_FRAGMENT_SHADER, fragmentData, fragmentShader } });
 }
 
 void Shader::bind()
@@ -302,4 +422,46 @@ GLint getUniform(GLuint shaderId, const char* name)
 		std::cout << "uniform error " + std::string(name);
 	}
 	return uniform;
+}
+
+std::map<int, std::string> parseShaderLog(const std::string& log, int lineOffset)
+{
+	std::map<int, std::string> markers;
+
+	std::istringstream iss(log);
+	std::string line;
+
+	while (std::getline(iss, line)) {
+		// typical GLSL formats:
+		// 0(17) : error C1008: ...
+		// ERROR: 0:17: 'xxx' : error
+		int lineNum = -1;
+
+		// Pattern 1: 0(17)
+		size_t open = line.find('(');
+		size_t close = line.find(')');
+		if (open != std::string::npos && close != std::string::npos && close > open) {
+			try {
+				lineNum = std::stoi(line.substr(open + 1, close - open - 1));
+			}
+			catch (...) {}
+		}
+
+		// Pattern 2: ERROR: 0:17:
+		size_t colon1 = line.find(':');
+		size_t colon2 = line.find(':', colon1 + 1);
+		if (colon1 != std::string::npos && colon2 != std::string::npos) {
+			try {
+				lineNum = std::stoi(line.substr(colon1 + 1, colon2 - colon1 - 1));
+			}
+			catch (...) {}
+		}
+
+		lineNum -= lineOffset;
+		if (lineNum >= 1) {
+			markers[lineNum] = line;
+		}
+	}
+
+	return markers;
 }
\ No newline at end of file
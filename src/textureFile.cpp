@@ -0,0 +1,243 @@
+#include <textureFile.h>
+#include <imageDecoder.h>
+#include <audioChannel.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+static const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t ktxHeaderSize = 64;
+static const uint32_t binSignature = 0x004e4942;	// "BIN\0"
+static const size_t binHeaderSize = 20;
+
+static uint32_t readU32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static size_t align4(size_t n)
+{
+	return (n + 3) & ~(size_t)3;
+}
+
+static int getComponentCount(GLenum format)
+{
+	switch (format)
+	{
+	case GL_RED: return 1;
+	case GL_RG: return 2;
+	case GL_RGB: return 3;
+	case GL_RGBA: return 4;
+	default: return 0;
+	}
+}
+
+static int getTypeSize(GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_HALF_FLOAT: return 2;
+	case GL_FLOAT: return 4;
+	default: return 0;
+	}
+}
+
+static bool parseKTX(const unsigned char* data, size_t size, TextureLayout& layout, std::string& error)
+{
+	if (size < ktxHeaderSize)
+	{
+		error = "truncated KTX header";
+		return false;
+	}
+	if (readU32(data + 12) != 0x04030201)
+	{
+		error = "KTX file of the other endianness";
+		return false;
+	}
+
+	GLenum type = readU32(data + 16);
+	GLenum format = readU32(data + 24);
+	GLenum internalFormat = readU32(data + 28);
+	int width = (int)readU32(data + 36);
+	int height = (int)readU32(data + 40);
+	int depth = (int)readU32(data + 44);
+	uint32_t arrayElements = readU32(data + 48);
+	uint32_t faces = readU32(data + 52);
+	uint32_t keyValueBytes = readU32(data + 60);
+
+	if (type == 0)
+	{
+		error = "compressed KTX data isn't supported";
+		return false;
+	}
+	if (getComponentCount(format) == 0 || getTypeSize(type) == 0)
+	{
+		error = "unsupported KTX pixel format";
+		return false;
+	}
+	if (arrayElements > 0 || (faces != 1 && faces != 6) || (faces == 6 && depth > 0) || width <= 0 || height <= 0)
+	{
+		error = "only 2D, 3D and cubemap KTX files are supported";
+		return false;
+	}
+
+	size_t offset = ktxHeaderSize + keyValueBytes;
+	if (offset + 4 > size)
+	{
+		error = "truncated KTX file";
+		return false;
+	}
+	size_t imageSize = readU32(data + offset);
+	offset += 4;
+
+	layout.width = width;
+	layout.height = height;
+	layout.depth = std::max(depth, 1);
+	layout.internalFormat = internalFormat;
+	layout.format = format;
+	layout.type = type;
+	layout.unpackAlignment = 4;	// KTX pads rows to 4 bytes
+	layout.rowBytes = align4((size_t)width * getComponentCount(format) * getTypeSize(type));
+	layout.data = data + offset;
+	layout.flipRows = false;	// stored the way glTexImage takes them
+
+	if (faces == 6)
+	{
+		// imageSize is one face, each face padded to 4 bytes
+		layout.target = GL_TEXTURE_CUBE_MAP;
+		layout.layers = 6;
+		layout.layerStride = align4(imageSize);
+	}
+	else
+	{
+		layout.target = depth > 0 ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+		layout.layers = layout.depth;
+		layout.layerStride = layout.rowBytes * height;
+	}
+
+	if (layout.rowBytes * height > layout.layerStride || offset + layout.layerStride * (layout.layers - 1) + layout.rowBytes * height > size)
+	{
+		error = "truncated KTX image data";
+		return false;
+	}
+	return true;
+}
+
+// shadertoy.com's volumes: a 20 byte header, then tightly packed texels
+static bool parseBIN(const unsigned char* data, size_t size, TextureLayout& layout, std::string& error)
+{
+	if (size < binHeaderSize)
+	{
+		error = "truncated volume header";
+		return false;
+	}
+
+	int width = (int)readU32(data + 4);
+	int height = (int)readU32(data + 8);
+	int depth = (int)readU32(data + 12);
+	int channels = data[16];
+	bool interleaved = data[17] == 0;
+	int format = data[18] | (data[19] << 8);
+
+	static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	static const GLenum bytes[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	static const GLenum floats[4] = { GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+
+	if (channels < 1 || channels > 4 || !interleaved || (format != 0 && format != 10) || width <= 0 || height <= 0 || depth <= 0)
+	{
+		error = "unsupported volume format";
+		return false;
+	}
+
+	layout.target = GL_TEXTURE_3D;
+	layout.width = width;
+	layout.height = height;
+	layout.depth = depth;
+	layout.layers = depth;
+	layout.format = formats[channels - 1];
+	layout.internalFormat = format == 10 ? floats[channels - 1] : bytes[channels - 1];
+	layout.type = format == 10 ? GL_FLOAT : GL_UNSIGNED_BYTE;
+	layout.unpackAlignment = 1;
+	layout.rowBytes = (size_t)width * channels * (format == 10 ? 4 : 1);
+	layout.layerStride = layout.rowBytes * height;
+	layout.data = data + binHeaderSize;
+	layout.flipRows = false;
+
+	if (binHeaderSize + layout.getTotalBytes() > size)
+	{
+		error = "truncated volume data";
+		return false;
+	}
+	return true;
+}
+
+bool parseTextureFile(const unsigned char* data, size_t size, TextureLayout& layout, std::string& error)
+{
+	layout = TextureLayout();
+
+	if (size >= sizeof(ktxIdentifier) && memcmp(data, ktxIdentifier, sizeof(ktxIdentifier)) == 0)
+	{
+		return parseKTX(data, size, layout, error);
+	}
+	if (size >= 4 && readU32(data) == binSignature)
+	{
+		return parseBIN(data, size, layout, error);
+	}
+
+	error = "unknown texture format";
+	return false;
+}
+
+static std::string getExtension(const std::string& name)
+{
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos) { return ""; }
+
+	std::string extension = name.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension;
+}
+
+bool isTextureFileName(const std::string& name)
+{
+	std::string extension = getExtension(name);
+	return extension == "ktx" || extension == "bin";
+}
+
+bool isChannelFileName(const std::string& name)
+{
+	return isImageFileName(name) || isTextureFileName(name) || isAudioChannelName(name);
+}
+
+GLenum getChannelFileTarget(const std::string& path)
+{
+	if (!isTextureFileName(path)) { return GL_TEXTURE_2D; }
+
+	// the header is all it takes, the data stays on disk
+	unsigned char header[ktxHeaderSize] = {};
+	std::ifstream in(path, std::ios::binary);
+	in.read((char*)header, sizeof(header));
+
+	if (readU32(header) == binSignature) { return GL_TEXTURE_3D; }
+	if (memcmp(header, ktxIdentifier, sizeof(ktxIdentifier)) == 0)
+	{
+		if (readU32(header + 52) == 6) { return GL_TEXTURE_CUBE_MAP; }
+		if (readU32(header + 44) > 0) { return GL_TEXTURE_3D; }
+	}
+	return GL_TEXTURE_2D;
+}
+
+const char* getSamplerTypeName(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_3D: return "sampler3D";
+	case GL_TEXTURE_CUBE_MAP: return "samplerCube";
+	default: return "sampler2D";
+	}
+}
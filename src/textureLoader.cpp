@@ -0,0 +1,481 @@
+#include <textureLoader.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// FNV-1a, only used to find identical files
+static uint64_t hashBytes(const unsigned char* bytes, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash ? hash : 1;	// 0 means "not loaded yet"
+}
+
+// how far ahead of the upload mapped files are read in
+static const size_t prefetchBytes = 16 << 20;
+
+// the same file under another name, as far as the file system can tell
+static uint64_t hashFileIdentity(const std::string& path, size_t size)
+{
+	std::error_code error;
+	std::string name = std::filesystem::weakly_canonical(path, error).string();
+	long long modified = (long long)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+	uint64_t hash = hashBytes((const unsigned char*)name.data(), name.size());
+	hash = hashBytes((const unsigned char*)&size, sizeof(size), hash);
+	return hashBytes((const unsigned char*)&modified, sizeof(modified), hash);
+}
+
+bool TextureLoader::init(int threads)
+{
+	clear();
+
+	if (threads <= 0)
+	{
+		// leave a core for the render thread, decoding is rarely worth more than a few
+		int cores = (int)std::thread::hardware_concurrency();
+		threads = std::min(std::max(cores - 1, 1), 4);
+	}
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3DTextureSize);
+	glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxCubeMapSize);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	glGenBuffers(1, &unpackBuffer);
+
+	running = true;
+	for (int i = 0; i < threads; i++)
+	{
+		workers.emplace_back(&TextureLoader::workerLoop, this);
+	}
+	return true;
+}
+
+void TextureLoader::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		jobs.clear();
+	}
+	wake.notify_all();
+	for (auto& w : workers) { w.join(); }
+	workers.clear();
+
+	results.clear();
+	claimedHashes.clear();
+
+	for (auto& t : textures)
+	{
+		if (t.second.id) { glDeleteTextures(1, &t.second.id); }
+	}
+	textures.clear();
+	requests.clear();
+	failedHashes.clear();
+	uploads.clear();
+	loading = 0;
+
+	if (unpackBuffer) { glDeleteBuffers(1, &unpackBuffer); }
+	unpackBuffer = 0;
+}
+
+int TextureLoader::request(const std::string& path)
+{
+	for (int i = 0; i < (int)requests.size(); i++)
+	{
+		if (requests[i].refs > 0 && requests[i].path == path)
+		{
+			requests[i].refs++;
+			return i;
+		}
+	}
+
+	int handle = 0;
+	while (handle < (int)requests.size() && requests[handle].refs > 0) { handle++; }
+	if (handle == (int)requests.size()) { requests.emplace_back(); }
+
+	Request& r = requests[handle];
+	r.path = path;
+	r.refs = 1;
+	r.generation++;
+	r.hash = 0;
+	r.failed = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back({ handle, r.generation, path });
+	}
+	wake.notify_one();
+	loading++;
+	return handle;
+}
+
+void TextureLoader::release(int handle)
+{
+	if (handle < 0 || handle >= (int)requests.size() || requests[handle].refs <= 0) { return; }
+
+	Request& r = requests[handle];
+	if (--r.refs > 0) { return; }
+
+	// the texture itself goes once nothing in flight can still point at it
+	auto it = textures.find(r.hash);
+	if (it != textures.end()) { it->second.refs--; }
+	r.hash = 0;
+}
+
+void TextureLoader::update()
+{
+	std::vector<Result> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(results);
+	}
+	for (auto& r : done) { collect(r); }
+
+	// one texture finished per frame at most, building its mip chain isn't free either
+	size_t budget = uploadBudget;
+	while (!uploads.empty() && budget > 0)
+	{
+		auto it = textures.find(uploads.front());
+		if (it == textures.end())
+		{
+			uploads.pop_front();
+			continue;
+		}
+
+		bool finished = uploadRows(it->second, budget);
+		if (finished) { uploads.pop_front(); }
+		if (finished || budget == 0) { break; }
+	}
+
+	deleteUnused();
+}
+
+void TextureLoader::collect(Result& r)
+{
+	loading--;
+
+	Request* request = &requests[r.handle];
+	if (request->generation != r.generation || request->refs <= 0) { request = nullptr; }
+
+	if (!r.error.empty() || failedHashes.count(r.hash))
+	{
+		if (r.hash && !r.duplicate)
+		{
+			// duplicates that came back first are waiting on this one
+			failedHashes.insert(r.hash);
+			for (auto& other : requests)
+			{
+				if (other.refs > 0 && other.hash == r.hash)
+				{
+					other.failed = true;
+					other.hash = 0;
+					std::cout << "Failed to load " << other.path << ": " << r.error << "\n";
+				}
+			}
+			textures.erase(r.hash);
+		}
+		if (request)
+		{
+			request->failed = true;
+			std::cout << "Failed to load " << request->path << ": " << (r.error.empty() ? "same contents as a file that failed" : r.error) << "\n";
+		}
+		return;
+	}
+
+	// decoded images are kept even when their request is gone, a duplicate of
+	// them may still be on its way back
+	Texture& t = textures[r.hash];
+	if (!r.duplicate)
+	{
+		t.image = std::move(r.image);
+		t.file = std::move(r.file);
+		t.layout = r.layout;
+		if (!t.file.isOpen())
+		{
+			t.layout.data = t.image.pixels.data();
+		}
+		uploads.push_back(r.hash);
+	}
+
+	if (request)
+	{
+		request->hash = r.hash;
+		t.refs++;
+	}
+}
+
+bool TextureLoader::uploadRows(Texture& t, size_t& budget)
+{
+	const TextureLayout& l = t.layout;
+
+	if (!t.id)
+	{
+		int levels = 1;
+		int largest = std::max(std::max(l.width, l.height), l.target == GL_TEXTURE_3D ? l.depth : 1);
+		while ((largest >> levels) > 0) { levels++; }
+
+		// cubemaps are sampled by direction, repeating makes no sense for them
+		GLenum wrap = l.target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+		glGenTextures(1, &t.id);
+		glBindTexture(l.target, t.id);
+		if (l.target == GL_TEXTURE_3D)
+		{
+			glTexStorage3D(l.target, levels, l.internalFormat, l.width, l.height, l.depth);
+		}
+		else
+		{
+			glTexStorage2D(l.target, levels, l.internalFormat, l.width, l.height);
+		}
+		glTexParameteri(l.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(l.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(l.target, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(l.target, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(l.target, GL_TEXTURE_WRAP_R, wrap);
+	}
+
+	int layer = (int)(t.uploadedRows / l.height);
+	int row = (int)(t.uploadedRows % l.height);
+	int rows = (int)std::min<size_t>(std::max<size_t>(budget / l.rowBytes, 1), l.height - row);
+
+	// whole volume slices go several at a time when they are stored back to back
+	size_t sliceBytes = l.rowBytes * l.height;
+	int slices = 1;
+	if (l.target == GL_TEXTURE_3D && row == 0 && l.layerStride == sliceBytes)
+	{
+		slices = (int)std::min<size_t>(std::max<size_t>(budget / sliceBytes, 1), l.layers - layer);
+	}
+	size_t bytes = slices > 1 ? slices * sliceBytes : rows * l.rowBytes;
+
+	// orphaning hands out fresh memory, so the copy never waits for the last upload
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	const unsigned char* src = l.data + layer * l.layerStride + row * l.rowBytes;
+	int y = row;
+	if (dst)
+	{
+		if (l.flipRows)
+		{
+			// decoded rows are top first, GL's bottom first
+			for (int i = 0; i < rows; i++)
+			{
+				memcpy(dst + (rows - 1 - i) * l.rowBytes, src + i * l.rowBytes, l.rowBytes);
+			}
+			y = l.height - row - rows;
+		}
+		else
+		{
+			memcpy(dst, src, bytes);
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glBindTexture(l.target, t.id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, l.unpackAlignment);
+		if (l.target == GL_TEXTURE_3D)
+		{
+			glTexSubImage3D(l.target, 0, 0, y, layer, l.width, slices > 1 ? l.height : rows, slices, l.format, l.type, nullptr);
+		}
+		else
+		{
+			GLenum face = l.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer : l.target;
+			glTexSubImage2D(face, 0, 0, y, l.width, rows, l.format, l.type, nullptr);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	t.uploadedRows += slices > 1 ? (size_t)slices * l.height : rows;
+	budget -= std::min(budget, bytes);
+
+	if (t.uploadedRows < (size_t)l.height * l.layers)
+	{
+		// have the next frames' share read in from disk meanwhile
+		if (t.file.isOpen()) { t.file.prefetch((size_t)(src + bytes - t.file.getData()), prefetchBytes); }
+		glBindTexture(l.target, 0);
+		return false;
+	}
+
+	glGenerateMipmap(l.target);
+	glBindTexture(l.target, 0);
+	t.image = DecodedImage();
+	t.file.close();
+	t.layout.data = nullptr;
+	t.ready = true;
+	return true;
+}
+
+void TextureLoader::deleteUnused()
+{
+	if (loading > 0) { return; }
+
+	for (auto it = textures.begin(); it != textures.end();)
+	{
+		if (it->second.refs > 0)
+		{
+			++it;
+			continue;
+		}
+
+		if (it->second.id) { glDeleteTextures(1, &it->second.id); }
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			claimedHashes.erase(it->first);
+		}
+		it = textures.erase(it);
+	}
+}
+
+bool TextureLoader::getTexture(int handle, GLuint& texture, GLenum& target, int size[3]) const
+{
+	texture = 0;
+	target = GL_TEXTURE_2D;
+	size[0] = size[1] = size[2] = 0;
+	if (handle < 0 || handle >= (int)requests.size() || !requests[handle].hash) { return false; }
+
+	auto it = textures.find(requests[handle].hash);
+	if (it == textures.end() || !it->second.ready) { return false; }
+
+	const TextureLayout& l = it->second.layout;
+	texture = it->second.id;
+	target = l.target;
+	size[0] = l.width;
+	size[1] = l.height;
+	size[2] = l.target == GL_TEXTURE_3D ? l.depth : 1;
+	return true;
+}
+
+bool TextureLoader::getResidency(int handle, size_t& uploaded, size_t& total) const
+{
+	uploaded = total = 0;
+	if (handle < 0 || handle >= (int)requests.size() || !requests[handle].hash) { return false; }
+
+	auto it = textures.find(requests[handle].hash);
+	if (it == textures.end()) { return false; }
+
+	// level 0 only, the mips add a third at most
+	const TextureLayout& l = it->second.layout;
+	total = l.getTotalBytes();
+	uploaded = it->second.ready ? total : it->second.uploadedRows * l.rowBytes;
+	return true;
+}
+
+bool TextureLoader::hasFailed(int handle) const
+{
+	return handle >= 0 && handle < (int)requests.size() && requests[handle].failed;
+}
+
+bool TextureLoader::isBusy() const
+{
+	return loading > 0 || !uploads.empty();
+}
+
+void TextureLoader::finish()
+{
+	size_t budget = uploadBudget;
+	uploadBudget = SIZE_MAX;
+	while (isBusy())
+	{
+		update();
+		if (loading > 0) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+	}
+	uploadBudget = budget;
+}
+
+void TextureLoader::workerLoop()
+{
+	while (true)
+	{
+		Job j;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return !jobs.empty() || !running; });
+			if (!running) { break; }
+
+			j = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		Result r;
+		r.handle = j.handle;
+		r.generation = j.generation;
+		load(j, r);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		results.push_back(std::move(r));
+	}
+}
+
+void TextureLoader::load(const Job& j, Result& r)
+{
+	if (isTextureFileName(j.path))
+	{
+		if (!r.file.open(j.path))
+		{
+			r.error = "can't map the file";
+			return;
+		}
+
+		r.hash = hashFileIdentity(j.path, r.file.getSize());
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			r.duplicate = !claimedHashes.insert(r.hash).second;
+		}
+		if (r.duplicate)
+		{
+			r.file.close();
+			return;
+		}
+
+		if (!parseTextureFile(r.file.getData(), r.file.getSize(), r.layout, r.error))
+		{
+			r.file.close();
+			return;
+		}
+
+		GLint maxSize = r.layout.target == GL_TEXTURE_3D ? max3DTextureSize :
+			r.layout.target == GL_TEXTURE_CUBE_MAP ? maxCubeMapSize : maxTextureSize;
+		if (r.layout.width > maxSize || r.layout.height > maxSize || (r.layout.target == GL_TEXTURE_3D && r.layout.depth > maxSize))
+		{
+			r.error = "larger than the GPU allows";
+			r.file.close();
+			return;
+		}
+
+		// the first frames' share, the rest is asked for as the upload gets there
+		r.file.prefetch((size_t)(r.layout.data - r.file.getData()), prefetchBytes);
+		return;
+	}
+
+	std::ifstream in(j.path, std::ios::binary);
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (!in.is_open() || bytes.empty())
+	{
+		r.error = "can't read the file";
+		return;
+	}
+
+	r.hash = hashBytes(bytes.data(), bytes.size());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		r.duplicate = !claimedHashes.insert(r.hash).second;
+	}
+	if (r.duplicate || !decodeImage(bytes.data(), bytes.size(), maxTextureSize, r.image, r.error)) { return; }
+
+	r.layout.width = r.image.width;
+	r.layout.height = r.image.height;
+	r.layout.internalFormat = r.image.hdr ? GL_RGBA16F : GL_RGBA8;
+	r.layout.type = r.image.hdr ? GL_FLOAT : GL_UNSIGNED_BYTE;
+	r.layout.rowBytes = (size_t)r.image.width * r.image.getBytesPerPixel();
+	r.layout.layerStride = r.layout.rowBytes * r.image.height;
+	r.layout.flipRows = true;
+}
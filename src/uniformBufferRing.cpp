@@ -0,0 +1,141 @@
+#include <uniformBufferRing.h>
+#include <iostream>
+#include <cstring>
+
+bool UniformBufferRing::init(GLsizeiptr blockSize, int slotCount)
+{
+	clear();
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment <= 0) { alignment = 256; }
+
+	this->blockSize = blockSize;
+	stride = (blockSize + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_UNIFORM_BUFFER, id);
+
+	if (glBufferStorage)
+	{
+		this->slotCount = slotCount;
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, stride * slotCount, nullptr, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride * slotCount, flags);
+
+		if (!mapped)
+		{
+			std::cout << "Error mapping uniform buffer ring\n";
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			clear();
+			return false;
+		}
+	}
+	else
+	{
+		// no persistent mapping before GL 4.4, a single slot updated in place
+		this->slotCount = 1;
+		glBufferData(GL_UNIFORM_BUFFER, stride, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	fences.assign(this->slotCount, (GLsync)0);
+	last.resize(blockSize);
+	return true;
+}
+
+void UniformBufferRing::clear()
+{
+	for (auto f : fences)
+	{
+		if (f) { glDeleteSync(f); }
+	}
+	fences.clear();
+
+	if (id)
+	{
+		if (mapped)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, id);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &id);
+	}
+
+	id = 0;
+	mapped = nullptr;
+	current = -1;
+	hasLast = false;
+	written = false;
+	reused = false;
+	bound = false;
+}
+
+bool UniformBufferRing::write(const void* data, GLuint bindingPoint)
+{
+	if (!id) { return false; }
+
+	if (hasLast && bound && boundPoint == bindingPoint && memcmp(last.data(), data, blockSize) == 0)
+	{
+		return false;
+	}
+
+	int next = (current + 1) % slotCount;
+
+	if (mapped && reused)
+	{
+		// the fence now follows every draw that read the slot we leave
+		glDeleteSync(fences[current]);
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		reused = false;
+	}
+
+	if (mapped)
+	{
+		// only stalls when the CPU is a full ring ahead of the GPU
+		if (GLsync f = fences[next])
+		{
+			while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+			glDeleteSync(f);
+			fences[next] = 0;
+		}
+
+		memcpy(mapped + next * stride, data, blockSize);
+	}
+	else
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, id);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, blockSize, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, id, next * stride, blockSize);
+
+	memcpy(last.data(), data, blockSize);
+	hasLast = true;
+	written = true;
+	bound = true;
+	boundPoint = bindingPoint;
+	current = next;
+	return true;
+}
+
+void UniformBufferRing::fence()
+{
+	if (!mapped || current < 0) { return; }
+
+	// when nothing changed the slot keeps its fence and write() renews it
+	if (!written)
+	{
+		reused = true;
+		return;
+	}
+
+	if (fences[current]) { glDeleteSync(fences[current]); }
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	written = false;
+	reused = false;
+}
@@ -0,0 +1,404 @@
+#include <videoWriter.h>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHADERTOY_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <csignal>
+#endif
+
+// rows converted per task, even so chroma rows never straddle two tasks
+static const int stripeRows = 64;
+
+// Full range BT.601 in 8 bit fixed point
+static inline unsigned char clampByte(int v)
+{
+	return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static inline unsigned char lumaOf(const unsigned char* p)
+{
+	return (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+}
+
+// r, g, b are sums over 4 pixels
+static inline unsigned char chromaU(int r, int g, int b)
+{
+	return clampByte((-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10);
+}
+
+static inline unsigned char chromaV(int r, int g, int b)
+{
+	return clampByte((128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10);
+}
+
+#ifdef SHADERTOY_SSE2
+
+// 2 pixels widened to 16 bit in, their weighted sums in lanes 0 and 2 out
+static inline __m128i weighPair(__m128i pixels, __m128i weights)
+{
+	__m128i m = _mm_madd_epi16(pixels, weights);
+	return _mm_add_epi32(m, _mm_srli_epi64(m, 32));
+}
+
+// lanes 0 and 2 of a and b into 4 lanes
+static inline __m128i gatherEven(__m128i a, __m128i b)
+{
+	a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+	b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_unpacklo_epi64(a, b);
+}
+
+// 8 pixels of one row
+static inline __m128i luma8(__m128i p0, __m128i p1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+	const __m128i round = _mm_set1_epi32(128);
+
+	__m128i a = gatherEven(weighPair(_mm_unpacklo_epi8(p0, zero), weights), weighPair(_mm_unpackhi_epi8(p0, zero), weights));
+	__m128i b = gatherEven(weighPair(_mm_unpacklo_epi8(p1, zero), weights), weighPair(_mm_unpackhi_epi8(p1, zero), weights));
+
+	a = _mm_srai_epi32(_mm_add_epi32(a, round), 8);
+	b = _mm_srai_epi32(_mm_add_epi32(b, round), 8);
+
+	__m128i y16 = _mm_packs_epi32(a, b);
+	return _mm_packus_epi16(y16, y16);
+}
+
+// 2x2 block sums of 4 pixels from each row, as two blocks of 16 bit RGBA
+static inline __m128i blockSums(__m128i top, __m128i bottom)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+	__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+	lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+	hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+static inline void chroma4(__m128i blocks0, __m128i blocks1, __m128i weights, unsigned char* out)
+{
+	const __m128i round = _mm_set1_epi32((128 << 10) + 512);
+
+	__m128i c = gatherEven(weighPair(blocks0, weights), weighPair(blocks1, weights));
+	c = _mm_srai_epi32(_mm_add_epi32(c, round), 10);
+
+	__m128i c16 = _mm_packs_epi32(c, c);
+	int packed = _mm_cvtsi128_si32(_mm_packus_epi16(c16, c16));
+	memcpy(out, &packed, 4);
+}
+
+#endif
+
+void convertRGBAToI420(const unsigned char* rgba, size_t stride, int width, int height,
+	unsigned char* y, unsigned char* u, unsigned char* v, int firstRow, int endRow)
+{
+	int chromaWidth = (width + 1) / 2;
+
+	for (int row = firstRow; row < endRow; row += 2)
+	{
+		bool hasSecondRow = row + 1 < height;
+
+		// GL rows go bottom up
+		const unsigned char* top = rgba + (size_t)(height - 1 - row) * stride;
+		const unsigned char* bottom = hasSecondRow ? top - stride : top;
+
+		unsigned char* yTop = y + (size_t)row * width;
+		unsigned char* yBottom = hasSecondRow ? yTop + width : nullptr;
+		unsigned char* uRow = u + (size_t)(row / 2) * chromaWidth;
+		unsigned char* vRow = v + (size_t)(row / 2) * chromaWidth;
+
+		int x = 0;
+
+#ifdef SHADERTOY_SSE2
+		const __m128i weightsU = _mm_setr_epi16(-43, -85, 128, 0, -43, -85, 128, 0);
+		const __m128i weightsV = _mm_setr_epi16(128, -107, -21, 0, 128, -107, -21, 0);
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i t0 = _mm_loadu_si128((const __m128i*)(top + x * 4));
+			__m128i t1 = _mm_loadu_si128((const __m128i*)(top + x * 4 + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(bottom + x * 4));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(bottom + x * 4 + 16));
+
+			_mm_storel_epi64((__m128i*)(yTop + x), luma8(t0, t1));
+			if (yBottom) { _mm_storel_epi64((__m128i*)(yBottom + x), luma8(b0, b1)); }
+
+			__m128i blocks0 = blockSums(t0, b0);
+			__m128i blocks1 = blockSums(t1, b1);
+			chroma4(blocks0, blocks1, weightsU, uRow + x / 2);
+			chroma4(blocks0, blocks1, weightsV, vRow + x / 2);
+		}
+#endif
+
+		for (; x < width; x += 2)
+		{
+			// an odd last column repeats its pixel
+			int x1 = x + 1 < width ? x + 1 : x;
+			const unsigned char* p[4] = { top + x * 4, top + x1 * 4, bottom + x * 4, bottom + x1 * 4 };
+
+			yTop[x] = lumaOf(p[0]);
+			if (x1 != x) { yTop[x1] = lumaOf(p[1]); }
+			if (yBottom)
+			{
+				yBottom[x] = lumaOf(p[2]);
+				if (x1 != x) { yBottom[x1] = lumaOf(p[3]); }
+			}
+
+			int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+			int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+			int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+			uRow[x / 2] = chromaU(r, g, b);
+			vRow[x / 2] = chromaV(r, g, b);
+		}
+	}
+}
+
+bool VideoWriter::open(const VideoWriterOptions& options)
+{
+	close();
+
+	if (options.width <= 0 || options.height <= 0 || options.output.empty())
+	{
+		std::cout << "Bad video writer settings\n";
+		return false;
+	}
+
+	this->options = options;
+
+	pipe = options.output[0] == '|';
+	if (pipe)
+	{
+#ifndef _WIN32
+		// an encoder that quits early should fail the write, not kill us
+		signal(SIGPIPE, SIG_IGN);
+		file = popen(options.output.c_str() + 1, "w");
+#else
+		file = popen(options.output.c_str() + 1, "wb");
+#endif
+	}
+	else
+	{
+		file = fopen(options.output.c_str(), "wb");
+		if (file) { setvbuf(file, nullptr, _IOFBF, 4 << 20); }
+	}
+
+	if (!file)
+	{
+		std::cout << "Error opening video output " << options.output << "\n";
+		return false;
+	}
+
+	if (!options.raw)
+	{
+		fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+			options.width, options.height, options.fpsNumerator, options.fpsDenominator);
+	}
+
+	size_t chromaBytes = (size_t)((options.width + 1) / 2) * ((options.height + 1) / 2);
+	frameBytes = (size_t)options.width * options.height + 2 * chromaBytes;
+
+	frames.clear();
+	frames.resize(std::max(options.queueFrames, 1));
+	for (auto& f : frames) { f.yuv.resize(frameBytes); }
+
+	stopping = false;
+	failed = false;
+	nextSequence = 0;
+	nextWrite = 0;
+	written = 0;
+	heldSources = 0;
+	opened = true;
+
+	int threadCount = options.threads;
+	if (threadCount <= 0)
+	{
+		// leave room for the render thread and the writer
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		converters.emplace_back(&VideoWriter::converterLoop, this);
+	}
+	writer = std::thread(&VideoWriter::writerLoop, this);
+
+	return true;
+}
+
+void VideoWriter::close()
+{
+	if (!opened) { return; }
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	stripeReady.notify_all();
+	frameConverted.notify_all();
+
+	for (auto& t : converters) { t.join(); }
+	converters.clear();
+	writer.join();
+
+	if (pipe) { pclose(file); }
+	else { fclose(file); }
+	file = nullptr;
+
+	opened = false;
+	frameFreed.notify_all();
+	sourceReleased.notify_all();
+
+	if (failed)
+	{
+		std::cout << "Video output " << options.output << " failed, the recording is incomplete\n";
+	}
+}
+
+bool VideoWriter::submit(const ReadbackFrame& frame, ReadbackRing& ring)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!opened || stopping || frame.width != options.width || frame.height != options.height) { return false; }
+
+	int index = -1;
+	for (int i = 0; i < (int)frames.size(); i++)
+	{
+		if (frames[i].state == FrameFree) { index = i; break; }
+	}
+	if (index < 0) { return false; }
+
+	QueuedFrame& f = frames[index];
+	f.source = frame;
+	f.ring = &ring;
+	f.sequence = nextSequence++;
+	f.state = FrameConverting;
+	f.stripesLeft = 0;
+	heldSources++;
+
+	for (int row = 0; row < options.height; row += stripeRows)
+	{
+		stripes.push_back({ index, row, std::min(row + stripeRows, options.height) });
+		f.stripesLeft++;
+	}
+
+	stripeReady.notify_all();
+	return true;
+}
+
+void VideoWriter::waitForSpace()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	frameFreed.wait(lock, [&]
+	{
+		return !opened || std::any_of(frames.begin(), frames.end(), [](const QueuedFrame& f) { return f.state == FrameFree; });
+	});
+}
+
+void VideoWriter::waitForRelease(int heldLimit)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	sourceReleased.wait(lock, [&] { return !opened || heldSources < heldLimit; });
+}
+
+long long VideoWriter::getWrittenFrames()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+bool VideoWriter::hasFailed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
+
+void VideoWriter::converterLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		stripeReady.wait(lock, [&] { return stopping || !stripes.empty(); });
+		if (stripes.empty()) { return; }
+
+		Stripe s = stripes.front();
+		stripes.pop_front();
+		QueuedFrame& f = frames[s.frame];
+
+		lock.unlock();
+
+		int width = options.width;
+		int height = options.height;
+		unsigned char* y = f.yuv.data();
+		unsigned char* u = y + (size_t)width * height;
+		unsigned char* v = u + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+
+		// reads straight from the mapped pixel buffer
+		convertRGBAToI420(f.source.pixels, f.source.stride, width, height, y, u, v, s.firstRow, s.endRow);
+
+		lock.lock();
+
+		if (--f.stripesLeft == 0)
+		{
+			f.ring->release(f.source);
+			f.source = ReadbackFrame();
+			f.state = FrameConverted;
+			heldSources--;
+			frameConverted.notify_all();
+			sourceReleased.notify_all();
+		}
+	}
+}
+
+void VideoWriter::writerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		QueuedFrame* next = nullptr;
+		frameConverted.wait(lock, [&]
+		{
+			next = nullptr;
+			for (auto& f : frames)
+			{
+				if (f.state == FrameConverted && f.sequence == nextWrite) { next = &f; }
+			}
+			return next || (stopping && nextWrite == nextSequence);
+		});
+
+		if (!next) { return; }
+
+		bool skip = failed;
+		lock.unlock();
+
+		bool ok = true;
+		if (!skip)
+		{
+			// after a failure frames are still drained so nobody waits on them
+			if (!options.raw) { ok = fwrite("FRAME\n", 1, 6, file) == 6; }
+			ok = ok && fwrite(next->yuv.data(), 1, frameBytes, file) == frameBytes;
+		}
+
+		lock.lock();
+
+		if (!ok) { failed = true; }
+		if (!skip && ok) { written++; }
+
+		next->state = FrameFree;
+		nextWrite++;
+		frameFreed.notify_all();
+	}
+}